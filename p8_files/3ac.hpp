@@ -4,7 +4,9 @@
 #include <assert.h>
 #include <list>
 #include <map>
+#include <mutex>
 #include <set>
+#include <vector>
 #include "err.hpp"
 #include "symbol_table.hpp"
 #include "types.hpp"
@@ -15,6 +17,8 @@ class TypeAnalysis;
 class Procedure;
 class IRProgram;
 class ControlFlowGraph;
+class BasicBlock;
+class X64Code;
 
 class Label{
 public:
@@ -40,7 +44,17 @@ public:
 	Opd(OpdWidth widthIn) : myWidth(widthIn){}
 	virtual std::string valString() = 0;
 	virtual std::string locString() = 0;
+	virtual void genLoad(X64Code& code, std::string dstReg) = 0;
+	virtual void genStore(X64Code& code, std::string srcReg) = 0;
+	//The operand as an x64 instruction names it: a register, a 
+	// memory location, or an immediate
+	virtual std::string operandX64() = 0;
 	virtual OpdWidth getWidth(){ return myWidth; }
+	//Set by the register allocator when the operand stays in one 
+	// register (e.g. "%rbx") for the whole procedure
+	void setRegister(std::string reg){ myReg = reg; }
+	std::string getRegister(){ return myReg; }
+	bool inRegister(){ return !myReg.empty(); }
 	static OpdWidth width(const DataType * type){
 		if (const BasicType * basic = type->asBasic()){
 			if (basic->isChar()){ return BYTE; }
@@ -53,6 +67,7 @@ public:
 	}
 private:
 	OpdWidth myWidth;
+	std::string myReg;
 };
 
 class SymOpd : public Opd{
@@ -67,6 +82,13 @@ public:
 		return mySym->getName();
 	}
 	const SemSymbol * getSym(){ return mySym; }
+	virtual void genLoad(X64Code& code, std::string dstReg)
+		override;
+	virtual void genStore(X64Code& code, std::string srcReg)
+		override;
+	virtual std::string operandX64() override;
+	void setMemoryLoc(std::string loc){ myLoc = loc; }
+	std::string getMemoryLoc(){ return myLoc; }
 private:
 	//Private Constructor
 	SymOpd(SemSymbol * sym, OpdWidth width)
@@ -87,6 +109,11 @@ public:
 	virtual std::string locString() override{
 		throw InternalError("Tried to get location of a constant");
 	}
+	virtual void genLoad(X64Code& code, std::string dstReg)
+		override;
+	virtual void genStore(X64Code& code, std::string srcReg)
+		override;
+	virtual std::string operandX64() override;
 private:
 	std::string val;
 };
@@ -94,7 +121,7 @@ private:
 class AuxOpd : public Opd{
 public:
 	AuxOpd(std::string nameIn, OpdWidth width) 
-	: Opd(width), name(nameIn) { }
+	: Opd(width), name(nameIn), isString(false) { }
 	virtual std::string valString() override{
 		return "[" + getName() + "]";
 	}
@@ -104,8 +131,51 @@ public:
 	std::string getName(){
 		return name;
 	}
+	virtual void genLoad(X64Code& code, std::string dstReg)
+		override;
+	virtual void genStore(X64Code& code, std::string srcReg)
+		override;
+	virtual std::string operandX64() override;
+	void setMemoryLoc(std::string loc){ myLoc = loc; }
+	std::string getMemoryLoc(){ return myLoc; }
+	//String literals live in the data section; loading one yields
+	// its address rather than its contents
+	void setStringLoc(std::string loc){ myLoc = loc; isString = true; }
+	bool isStringLit(){ return isString; }
 private:
 	std::string name;
+	std::string myLoc;
+	bool isString;
+};
+
+/**
+* One static definition of a SymOpd or AuxOpd while a procedure is in
+* SSA form. Versions only exist between SSA construction and 
+* destruction, which maps every version back onto a plain operand.
+**/
+class SSAOpd : public Opd{
+public:
+	SSAOpd(Opd * baseIn, size_t versionIn)
+	: Opd(baseIn->getWidth()), base(baseIn), version(versionIn){ }
+	virtual std::string valString() override{
+		return "[" + getName() + "]";
+	}
+	virtual std::string locString() override{
+		return getName();
+	}
+	std::string getName(){
+		return base->locString() + "." + std::to_string(version);
+	}
+	Opd * getBase(){ return base; }
+	size_t getVersion(){ return version; }
+	virtual void genLoad(X64Code& code, std::string dstReg)
+		override;
+	virtual void genStore(X64Code& code, std::string srcReg)
+		override;
+	virtual std::string operandX64() override;
+private:
+	Opd * base;
+	size_t version;
 };
 
 enum BinOp {
@@ -119,25 +189,107 @@ class Quad{
 public:
 	Quad();
 	void addLabel(Label * label);
-	Label * getLabel(){ return labels.front(); }
+	Label * getLabel(){
+		if (labels.empty()){ return nullptr; }
+		return labels.front();
+	}
+	const std::list<Label *>& getLabels(){ return labels; }
 	void clearLabels(){ labels.clear(); }
 	virtual std::string repr() = 0;
 	std::string commentStr();
 	virtual std::string toString(bool verbose=false);
+	virtual void codegenX64(X64Code& code) = 0;
+	void codegenLabels(X64Code& code);
 	void setComment(std::string commentIn);
+	Quad * getPrev(){ return prev; }
+	Quad * getNext(){ return next; }
 private:
 	std::string myComment;
 	std::list<Label *> labels;
 	OpdWidth width;
+	Quad * prev;
+	Quad * next;
+friend class QuadList;
+};
+
+/**
+* Walks quads along their intrusive links, forwards or backwards. The 
+* end position is the quad just past the walk (or nullptr), so 
+* unlinking the quad under the iterator invalidates it.
+**/
+class QuadIterator{
+public:
+	QuadIterator(Quad * posIn, bool backwardIn)
+	: pos(posIn), backward(backwardIn){ }
+	Quad * operator*() const { return pos; }
+	QuadIterator& operator++(){
+		pos = backward ? pos->getPrev() : pos->getNext();
+		return *this;
+	}
+	bool operator==(const QuadIterator& other) const {
+		return pos == other.pos;
+	}
+	bool operator!=(const QuadIterator& other) const {
+		return pos != other.pos;
+	}
+private:
+	Quad * pos;
+	bool backward;
+};
+
+/**
+* A contiguous, non-empty run [first, last] of some QuadList. The range
+* does not own the quads, it only names the ends of the run.
+**/
+class QuadRange{
+public:
+	QuadRange(Quad * firstIn, Quad * lastIn)
+	: first(firstIn), last(lastIn){ }
+	QuadIterator begin() const { return QuadIterator(first, false); }
+	QuadIterator end() const { return QuadIterator(last->getNext(), false); }
+	QuadIterator rbegin() const { return QuadIterator(last, true); }
+	QuadIterator rend() const { return QuadIterator(first->getPrev(), true); }
+	Quad * front() const { return first; }
+	Quad * back() const { return last; }
+private:
+	Quad * first;
+	Quad * last;
+};
+
+/**
+* An intrusive doubly linked sequence of quads. The links are stored
+* in the quads themselves, so a quad is in at most one list at a time
+* and linking or unlinking a known quad is O(1).
+**/
+class QuadList{
+public:
+	QuadList() : head(nullptr), tail(nullptr){ }
+	bool empty() const { return head == nullptr; }
+	Quad * front() const { return head; }
+	Quad * back() const { return tail; }
+	QuadIterator begin() const { return QuadIterator(head, false); }
+	QuadIterator end() const { return QuadIterator(nullptr, false); }
+	void push_back(Quad * quad);
+	void insertBefore(Quad * pos, Quad * quad);
+	void remove(Quad * quad);
+	void replace(Quad * oldQuad, Quad * newQuad);
+private:
+	Quad * head;
+	Quad * tail;
 };
 
 class BinOpQuad : public Quad{
 public:
 	BinOpQuad(Opd * dstIn, BinOp opIn, Opd * src1In, Opd * src2In);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Opd * getDst(){ return dst; }
+	void setDst(Opd * opd){ dst = opd; }
 	Opd * getSrc1(){ return src1; }
 	Opd * getSrc2(){ return src2; }
+	void setSrc1(Opd * opd){ src1 = opd; }
+	void setSrc2(Opd * opd){ src2 = opd; }
+	BinOp getOp(){ return op; }
 private:
 	Opd * dst;
 	BinOp op;
@@ -149,8 +301,12 @@ class UnaryOpQuad : public Quad {
 public:
 	UnaryOpQuad(Opd * dstIn, UnaryOp opIn, Opd * srcIn);
 	std::string repr() override ;
+	void codegenX64(X64Code& code) override;
 	Opd * getDst(){ return dst; }
+	void setDst(Opd * opd){ dst = opd; }
 	Opd * getSrc(){ return src; }
+	void setSrc(Opd * opd){ src = opd; }
+	UnaryOp getOp(){ return op; }
 private:
 	Opd * dst;
 	UnaryOp op;
@@ -164,8 +320,11 @@ public:
 	: dst(dstIn), src(srcIn)
 	{ }
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Opd * getDst(){ return dst; }
+	void setDst(Opd * opd){ dst = opd; }
 	Opd * getSrc(){ return src; }
+	void setSrc(Opd * opd){ src = opd; }
 private:
 	Opd * dst;
 	Opd * src;
@@ -175,7 +334,9 @@ class JmpQuad : public Quad {
 public:
 	JmpQuad(Label * tgtIn);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Label * getLabel(){ return tgt; }
+	void setTarget(Label * tgtIn){ tgt = tgtIn; }
 private:
 	Label * tgt;
 };
@@ -184,24 +345,79 @@ class JmpIfQuad : public Quad {
 public:
 	JmpIfQuad(Opd * cndIn, Label * tgtIn);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Label * getLabel(){ return tgt; }
+	void setTarget(Label * tgtIn){ tgt = tgtIn; }
 	Opd * getCnd(){ return cnd; }
+	void setCnd(Opd * opd){ cnd = opd; }
 private:
 	Opd * cnd;
 	Label * tgt;
 };
 
+//Jumps when src1 op src2 holds, for one of the comparison operators,
+// and falls through otherwise
+class JmpCmpQuad : public Quad {
+public:
+	JmpCmpQuad(BinOp opIn, Opd * src1In, Opd * src2In, Label * tgtIn);
+	std::string repr() override;
+	void codegenX64(X64Code& code) override;
+	Label * getLabel(){ return tgt; }
+	void setTarget(Label * tgtIn){ tgt = tgtIn; }
+	BinOp getOp(){ return op; }
+	Opd * getSrc1(){ return src1; }
+	Opd * getSrc2(){ return src2; }
+	void setSrc1(Opd * opd){ src1 = opd; }
+	void setSrc2(Opd * opd){ src2 = opd; }
+private:
+	BinOp op;
+	Opd * src1;
+	Opd * src2;
+	Label * tgt;
+};
+
 class NopQuad : public Quad {
 public:
 	NopQuad();
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
+};
+
+/**
+* dst := PHI(args), only present while a procedure is in SSA form. 
+* Phis sit at the top of their block and take one argument per
+* incoming edge, paired with the block the edge comes from. All of a
+* block's phis read their arguments at once, on the edge into the block.
+**/
+class PhiQuad : public Quad {
+public:
+	PhiQuad(Opd * dstIn) : dst(dstIn){ }
+	std::string repr() override;
+	void codegenX64(X64Code& code) override;
+	Opd * getDst(){ return dst; }
+	void setDst(Opd * opd){ dst = opd; }
+	void addArg(BasicBlock * pred, Opd * opd){ args.push_back({pred, opd}); }
+	size_t numArgs(){ return args.size(); }
+	BasicBlock * getPred(size_t idx){ return args[idx].first; }
+	void setPred(size_t idx, BasicBlock * pred){ args[idx].first = pred; }
+	Opd * getArg(size_t idx){ return args[idx].second; }
+	void setArg(size_t idx, Opd * opd){ args[idx].second = opd; }
+	void removeArg(size_t idx){ 
+		args.erase(args.begin() + static_cast<long>(idx)); 
+	}
+private:
+	Opd * dst;
+	std::vector<std::pair<BasicBlock *, Opd *>> args;
 };
 
 class IntrinsicOutputQuad : public Quad {
 public:
 	IntrinsicOutputQuad(Opd * arg, const DataType * type);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Opd * getSrc(){ return myArg; }
+	void setSrc(Opd * opd){ myArg = opd; }
+	const DataType * getType(){ return myType; }
 private:
 	Opd * myArg;
 	const DataType * myType;
@@ -211,7 +427,10 @@ class IntrinsicInputQuad : public Quad {
 public:
 	IntrinsicInputQuad(Opd * arg, const DataType * type);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Opd * getDst(){ return myArg; }
+	void setDst(Opd * opd){ myArg = opd; }
+	const DataType * getType(){ return myType; }
 private:
 	Opd * myArg;
 	const DataType * myType;
@@ -221,14 +440,22 @@ class CallQuad : public Quad{
 public:
 	CallQuad(SemSymbol * calleeIn);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
+	SemSymbol * getCallee(){ return callee; }
+	//A tail call tears down the caller's frame and jumps to the callee,
+	// which then returns straight to the caller's caller
+	void setTailOf(Procedure * caller){ tailOf = caller; }
+	bool isTail(){ return tailOf != nullptr; }
 private:
 	SemSymbol * callee;
+	Procedure * tailOf = nullptr;
 };
 
 class EnterQuad : public Quad{
 public:
 	EnterQuad(Procedure * proc);
 	virtual std::string repr() override;
+	void codegenX64(X64Code& code) override;
 private:
 	Procedure * myProc;
 };
@@ -237,6 +464,7 @@ class LeaveQuad : public Quad{
 public:
 	LeaveQuad(Procedure * proc);
 	virtual std::string repr() override;
+	void codegenX64(X64Code& code) override;
 private:
 	Procedure * myProc;
 };
@@ -245,7 +473,10 @@ class SetArgQuad : public Quad{
 public:
 	SetArgQuad(size_t indexIn, Opd * opdIn);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Opd * getSrc(){ return opd; }
+	void setSrc(Opd * opdIn){ opd = opdIn; }
+	size_t getIndex(){ return index; }
 private:
 	size_t index;
 	Opd * opd;
@@ -255,7 +486,10 @@ class GetArgQuad : public Quad{
 public:
 	GetArgQuad(size_t indexIn, Opd * opdIn);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Opd * getDst(){ return opd; }
+	void setDst(Opd * opdIn){ opd = opdIn; }
+	size_t getIndex(){ return index; }
 private:
 	size_t index;
 	Opd * opd;
@@ -265,7 +499,9 @@ class SetRetQuad : public Quad{
 public:
 	SetRetQuad(Opd * opdIn);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Opd * getSrc(){ return opd; }
+	void setSrc(Opd * opdIn){ opd = opdIn; }
 private:
 	Opd * opd;
 };
@@ -274,7 +510,9 @@ class GetRetQuad : public Quad{
 public:
 	GetRetQuad(Opd * opdIn);
 	std::string repr() override;
+	void codegenX64(X64Code& code) override;
 	Opd * getDst(){ return opd; }
+	void setDst(Opd * opdIn){ opd = opdIn; }
 private:
 	Opd * opd;
 };
@@ -292,23 +530,44 @@ public:
 	void gatherFormal(SemSymbol * sym);
 	SymOpd * getSymOpd(SemSymbol * sym);
 	AuxOpd * makeTmp(OpdWidth width);
+	//Hand back a temp once its value has been read for the last time.
+	// Under compact temps, makeTmp reuses it for the next temp of the
+	// same width; otherwise every temp stays fresh
+	void releaseTmp(Opd * opd);
+	//Lowering is over: temps made from here on (by the optimizer) are
+	// all fresh, since nothing tracks when theirs die
+	void endLowering(){ freeTemps.clear(); }
 
 	std::string toString(bool verbose=false); 
 	std::string getName();
 
+	//Optimization counters, reported in insertion order
+	void addStat(std::string name, size_t amount);
+	std::string statsString();
+
 	holeyc::Label * getLeaveLabel();
 
 	void toX64(std::ostream& out);
+	//Bytes reserved below the frame pointer, set by allocLocals
 	size_t arSize() const;
 	size_t numTemps() const;
-
-	std::list<Quad *> * getQuads(){
-		return bodyQuads;
+	//Callee-saved registers that the procedure's body writes
+	const std::vector<std::string>& getSavedRegs(){ return savedRegs; }
+	std::string savedRegLoc(size_t idx);
+	//A leaf whose frame fits in the red zone, the 128 bytes below %rsp
+	// that nothing else may touch. It is addressed from %rsp, so the
+	// procedure needs no prologue or epilogue at all
+	bool usesRedZone() const { return redZone; }
+
+	//The whole quad sequence, from the enter quad to the leave quad
+	QuadList * getQuads(){
+		return quads;
 	}
 	EnterQuad * getEnter(){ return enter; }
 	LeaveQuad * getLeave(){ return leave; }
 private:
-	void allocLocals();
+	void allocLocals(const std::map<Opd *, size_t>& slots);
+	std::string frameLoc(size_t offset);
 
 	EnterQuad * enter;
 	LeaveQuad * leave;
@@ -317,10 +576,15 @@ private:
 	IRProgram * myProg;
 	std::map<SemSymbol *, SymOpd *> locals;
 	std::list<AuxOpd *> temps; 
+	std::list<AuxOpd *> freeTemps;
 	std::list<SymOpd *> formals; 
-	std::list<Quad *> * bodyQuads;
+	QuadList * quads;
 	std::string myName;
 	size_t maxTmp;
+	std::vector<std::string> savedRegs;
+	size_t frameSize;
+	bool redZone;
+	std::list<std::pair<std::string, size_t>> stats;
 };
 
 class IRProgram{
@@ -339,11 +603,22 @@ public:
 	const DataType * nodeType(ASTNode * node);
 
 	std::string toString(bool verbose=false);
+	std::string statsString();
 
 	void toX64(std::ostream& out);
 	std::set<Opd *> globalSyms();
+	std::set<Opd *> stringSyms();
+
+	//Lower expressions heavier operand first and let procedures reuse
+	// temps whose values are dead (see Procedure::releaseTmp)
+	void setCompactTemps(bool compact){ compactTmps = compact; }
+	bool compactTemps() const { return compactTmps; }
 private:
 	TypeAnalysis * ta;
+	bool compactTmps = false;
+	//Guards the label and string counters (and the string table),
+	// which procedures optimized in parallel share
+	std::mutex counterLock;
 	size_t max_label = 0;
 	size_t str_idx = 0;
 	std::list<Procedure *> * procs; 
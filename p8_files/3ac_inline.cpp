@@ -0,0 +1,227 @@
+#include "3ac_inline.hpp"
+
+namespace holeyc{
+
+//The setargs right before the call, in index order
+static std::vector<SetArgQuad *> argsOf(CallQuad * call){
+	std::vector<SetArgQuad *> args;
+	Quad * quad = call->getPrev();
+	while (auto arg = dynamic_cast<SetArgQuad *>(quad)){
+		args.insert(args.begin(), arg);
+		quad = arg->getPrev();
+	}
+	return args;
+}
+
+static void moveLabels(Quad * from, Quad * to){
+	for (Label * label : from->getLabels()){
+		to->addLabel(label);
+	}
+	from->clearLabels();
+}
+
+size_t Inliner::runProgram(){
+	globals = prog->globalSyms();
+	strings = prog->stringSyms();
+	for (Procedure * proc : *prog->getProcs()){
+		byName[proc->getName()] = proc;
+	}
+	for (Procedure * proc : *prog->getProcs()){
+		std::set<Procedure *>& called = callees[proc];
+		for (Quad * quad : *proc->getQuads()){
+			if (auto call = dynamic_cast<CallQuad *>(quad)){
+				called.insert(byName[call->getCallee()->getName()]);
+			}
+		}
+	}
+
+	std::vector<Procedure *> order;
+	for (Procedure * proc : *prog->getProcs()){
+		visit(proc, order);
+	}
+
+	size_t total = 0;
+	for (Procedure * proc : order){
+		std::vector<CallQuad *> calls;
+		for (Quad * quad : *proc->getQuads()){
+			if (auto call = dynamic_cast<CallQuad *>(quad)){
+				calls.push_back(call);
+			}
+		}
+		size_t inlined = 0;
+		for (CallQuad * call : calls){
+			Procedure * callee = byName[call->getCallee()->getName()];
+			if (worthInlining(call, callee)){
+				inlineCall(proc, call, callee);
+				inlined++;
+			}
+		}
+		proc->addStat("inline.calls", inlined);
+		total += inlined;
+	}
+	return total;
+}
+
+//Callees ahead of their callers
+void Inliner::visit(Procedure * proc, std::vector<Procedure *>& order){
+	if (!visited.insert(proc).second){ return; }
+	for (Procedure * callee : callees[proc]){
+		visit(callee, order);
+	}
+	order.push_back(proc);
+}
+
+bool Inliner::reaches(Procedure * from, Procedure * to){
+	std::set<Procedure *> seen;
+	std::vector<Procedure *> stack(1, from);
+	while (!stack.empty()){
+		Procedure * proc = stack.back();
+		stack.pop_back();
+		for (Procedure * callee : callees[proc]){
+			if (callee == to){ return true; }
+			if (seen.insert(callee).second){
+				stack.push_back(callee);
+			}
+		}
+	}
+	return false;
+}
+
+//Inlining saves the call sequence on both sides: a setarg and a getarg
+// per argument, plus the call, the getret, the enter and the leave. A
+// literal argument is worth one more quad, for the folding it allows
+bool Inliner::worthInlining(CallQuad * call, Procedure * callee){
+	if (reaches(callee, callee)){ return false; }
+	std::vector<SetArgQuad *> args = argsOf(call);
+	if (args.size() != callee->getFormals().size()){ return false; }
+
+	size_t size = 0;
+	for (Quad * quad : *callee->getQuads()){
+		if (dynamic_cast<EnterQuad *>(quad)
+		    || dynamic_cast<LeaveQuad *>(quad)
+		    || dynamic_cast<GetArgQuad *>(quad)){
+			continue;
+		}
+		size++;
+	}
+	size_t saved = 2 * args.size() + 4;
+	for (SetArgQuad * arg : args){
+		if (dynamic_cast<LitOpd *>(arg->getSrc())){ saved++; }
+	}
+	return size <= limit + saved;
+}
+
+void Inliner::inlineCall(Procedure * callerIn, CallQuad * call,
+	Procedure * callee){
+	caller = callerIn;
+	opds.clear();
+	labels.clear();
+	QuadList * quads = caller->getQuads();
+	Label * after = caller->makeLabel();
+	labels[callee->getLeaveLabel()] = after;
+
+	std::vector<SetArgQuad *> args = argsOf(call);
+	size_t idx = 0;
+	for (SymOpd * formal : callee->getFormals()){
+		Quad * copy = new AssignQuad(mapOpd(formal), args[idx]->getSrc());
+		moveLabels(args[idx], copy);
+		quads->replace(args[idx], copy);
+		idx++;
+	}
+
+	//A call whose result is dropped has no getret after it
+	Opd * result = nullptr;
+	Quad * pos = call->getNext();
+	if (auto getRet = dynamic_cast<GetRetQuad *>(pos)){
+		result = getRet->getDst();
+		pos = getRet->getNext();
+		quads->remove(getRet);
+	}
+	Quad * start = new NopQuad();
+	moveLabels(call, start);
+	quads->replace(call, start);
+
+	Quad * quad = callee->getEnter()->getNext();
+	for (; quad != callee->getLeave(); quad = quad->getNext()){
+		Quad * copy = cloneQuad(quad, result);
+		if (copy == nullptr){
+			if (quad->getLabels().empty()){ continue; }
+			copy = new NopQuad();
+		}
+		for (Label * label : quad->getLabels()){
+			copy->addLabel(mapLabel(label));
+		}
+		quads->insertBefore(pos, copy);
+	}
+	Quad * end = new NopQuad();
+	end->addLabel(after);
+	quads->insertBefore(pos, end);
+}
+
+//The copy of a quad of the callee, or nullptr for one that has no
+// place in the caller
+Quad * Inliner::cloneQuad(Quad * quad, Opd * result){
+	if (auto binOp = dynamic_cast<BinOpQuad *>(quad)){
+		return new BinOpQuad(mapOpd(binOp->getDst()), binOp->getOp(),
+			mapOpd(binOp->getSrc1()), mapOpd(binOp->getSrc2()));
+	} else if (auto unOp = dynamic_cast<UnaryOpQuad *>(quad)){
+		return new UnaryOpQuad(mapOpd(unOp->getDst()), unOp->getOp(),
+			mapOpd(unOp->getSrc()));
+	} else if (auto assign = dynamic_cast<AssignQuad *>(quad)){
+		return new AssignQuad(mapOpd(assign->getDst()),
+			mapOpd(assign->getSrc()));
+	} else if (auto jmp = dynamic_cast<JmpQuad *>(quad)){
+		return new JmpQuad(mapLabel(jmp->getLabel()));
+	} else if (auto jmpIf = dynamic_cast<JmpIfQuad *>(quad)){
+		return new JmpIfQuad(mapOpd(jmpIf->getCnd()),
+			mapLabel(jmpIf->getLabel()));
+	} else if (auto jmpCmp = dynamic_cast<JmpCmpQuad *>(quad)){
+		return new JmpCmpQuad(jmpCmp->getOp(), mapOpd(jmpCmp->getSrc1()),
+			mapOpd(jmpCmp->getSrc2()), mapLabel(jmpCmp->getLabel()));
+	} else if (dynamic_cast<NopQuad *>(quad)){
+		return new NopQuad();
+	} else if (auto output = dynamic_cast<IntrinsicOutputQuad *>(quad)){
+		return new IntrinsicOutputQuad(mapOpd(output->getSrc()),
+			output->getType());
+	} else if (auto input = dynamic_cast<IntrinsicInputQuad *>(quad)){
+		return new IntrinsicInputQuad(mapOpd(input->getDst()),
+			input->getType());
+	} else if (auto call = dynamic_cast<CallQuad *>(quad)){
+		return new CallQuad(call->getCallee());
+	} else if (auto setArg = dynamic_cast<SetArgQuad *>(quad)){
+		return new SetArgQuad(setArg->getIndex(), 
+			mapOpd(setArg->getSrc()));
+	} else if (auto getRet = dynamic_cast<GetRetQuad *>(quad)){
+		return new GetRetQuad(mapOpd(getRet->getDst()));
+	} else if (auto setRet = dynamic_cast<SetRetQuad *>(quad)){
+		if (result == nullptr){ return nullptr; }
+		return new AssignQuad(result, mapOpd(setRet->getSrc()));
+	} else if (dynamic_cast<GetArgQuad *>(quad)){
+		return nullptr;
+	}
+	throw new InternalError("Unexpected quad in an inlined body");
+}
+
+//Globals, literals and strings are shared by every procedure. Anything
+// else the callee names gets a temp of the caller's on first sight
+Opd * Inliner::mapOpd(Opd * opd){
+	auto found = opds.find(opd);
+	if (found != opds.end()){ return found->second; }
+	if (globals.count(opd) > 0 || strings.count(opd) > 0){ return opd; }
+	if (!dynamic_cast<AuxOpd *>(opd) && !dynamic_cast<SymOpd *>(opd)){
+		return opd;
+	}
+	Opd * copy = caller->makeTmp(opd->getWidth());
+	opds[opd] = copy;
+	return copy;
+}
+
+Label * Inliner::mapLabel(Label * label){
+	auto found = labels.find(label);
+	if (found != labels.end()){ return found->second; }
+	Label * copy = caller->makeLabel();
+	labels[label] = copy;
+	return copy;
+}
+
+}
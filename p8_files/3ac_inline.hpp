@@ -0,0 +1,59 @@
+#ifndef HOLEYC_3AC_INLINE
+#define HOLEYC_3AC_INLINE
+
+#include "3ac.hpp"
+
+namespace holeyc{
+
+/**
+* Replaces calls with a copy of the callee's body, before any graph is
+* built, so each procedure's own optimization sees through them. The
+* callee's formals, locals and temps become fresh temps of the caller
+* and its labels fresh labels. The setargs turn into copies into the
+* formals, the setrets into copies into the getret's temp, and jumps
+* to the leave into jumps past the copied body.
+*
+* A call is inlined when the callee's size, less what the call itself
+* would have cost, is at most the limit. A procedure that can reach
+* itself through calls is never inlined. Callees are handled before
+* their callers, so the bodies a caller takes in are already inlined.
+**/
+class Inliner{
+public:
+	static const size_t DEFAULT_LIMIT = 10;
+
+	//Returns how many calls were inlined over the whole program
+	static size_t run(IRProgram * prog, size_t limit){
+		Inliner inliner(prog, limit);
+		return inliner.runProgram();
+	}
+private:
+	Inliner(IRProgram * progIn, size_t limitIn)
+	: prog(progIn), limit(limitIn){}
+	size_t runProgram();
+	void visit(Procedure * proc, std::vector<Procedure *>& order);
+	bool reaches(Procedure * from, Procedure * to);
+	bool worthInlining(CallQuad * call, Procedure * callee);
+	void inlineCall(Procedure * caller, CallQuad * call, 
+		Procedure * callee);
+	Quad * cloneQuad(Quad * quad, Opd * result);
+	Opd * mapOpd(Opd * opd);
+	Label * mapLabel(Label * label);
+
+	IRProgram * prog;
+	size_t limit;
+	std::set<Opd *> globals;
+	std::set<Opd *> strings;
+	std::map<std::string, Procedure *> byName;
+	std::map<Procedure *, std::set<Procedure *>> callees;
+	std::set<Procedure *> visited;
+
+	//The call being inlined
+	Procedure * caller = nullptr;
+	std::map<Opd *, Opd *> opds;
+	std::map<Label *, Label *> labels;
+};
+
+}
+
+#endif
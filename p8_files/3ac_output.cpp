@@ -2,8 +2,9 @@
 
 namespace holeyc{
 
-IRProgram * ProgramNode::to3AC(TypeAnalysis * ta){
+IRProgram * ProgramNode::to3AC(TypeAnalysis * ta, bool compactTemps){
 	IRProgram * prog = new IRProgram(ta);
+	prog->setCompactTemps(compactTemps);
 	for (auto global : *myGlobals){
 		global->to3AC(prog);
 	}
@@ -36,6 +37,7 @@ void FnDeclNode::to3AC(IRProgram * prog){
 	for (auto stmt : *myBody){
 		stmt->to3AC(proc);
 	}
+	proc->endLowering();
 }
 
 void FnDeclNode::to3AC(Procedure * proc){
@@ -87,6 +89,31 @@ Opd * TrueNode::flatten(Procedure * prog){
 	return res;
 }
 
+//The consumer of exp's result has read it for the last time
+static void doneWith(Procedure * proc, ExpNode * exp, Opd * res){
+	if (exp->yieldsTmp()){ proc->releaseTmp(res); }
+}
+
+static void addLabelNop(Procedure * proc, Label * label){
+	Quad * nop = new NopQuad();
+	nop->addLabel(label);
+	proc->addQuad(nop);
+}
+
+//The quads only test for false, so jumping on true hops over a jump
+void ExpNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	Opd * cond = flatten(proc);
+	if (jumpIf){
+		Label * skip = proc->makeLabel();
+		proc->addQuad(new JmpIfQuad(cond, skip));
+		proc->addQuad(new JmpQuad(target));
+		addLabelNop(proc, skip);
+	} else {
+		proc->addQuad(new JmpIfQuad(cond, target));
+	}
+	doneWith(proc, this, cond);
+}
+
 Opd * AssignExpNode::flatten(Procedure * proc){
 	Opd * rhs = mySrc->flatten(proc);
 	Opd * lhs = myDst->flatten(proc);
@@ -97,6 +124,7 @@ Opd * AssignExpNode::flatten(Procedure * proc){
 	AssignQuad * quad = new AssignQuad(lhs, rhs);
 	quad->setComment("Assign");
 	proc->addQuad(quad);
+	doneWith(proc, mySrc, rhs);
 	return lhs;
 }
 
@@ -121,6 +149,10 @@ static void argsTo3AC(Procedure * proc, std::list<ExpNode *> * args){
 		proc->addQuad(argQuad);
 		argIdx++;
 	}
+	auto argOpd = argOpds.begin();
+	for (auto elt : *args){
+		doneWith(proc, elt, *argOpd++);
+	}
 }
 
 Opd * CallExpNode::flatten(Procedure * proc){
@@ -141,8 +173,94 @@ Opd * CallExpNode::flatten(Procedure * proc){
 	}
 }
 
-Opd * NegNode::flatten(Procedure * proc){
+//Arguments are all held until the call, so an argument that needs
+// more temps is cheapest early, but they are never reordered
+size_t CallExpNode::regNeed(){
+	size_t held = 0;
+	size_t need = 1;
+	for (auto arg : *myArgs){
+		need = std::max(need, held + arg->regNeed());
+		if (arg->yieldsTmp()){ held++; }
+	}
+	return need;
+}
+
+bool CallExpNode::yieldsTmp(){
+	const FnType * calleeType = myID->getSymbol()->getDataType()->asFn();
+	return !calleeType->getReturnType()->isVoid();
+}
+
+//Lowering one child first holds its result (if a temp) while the
+// other is lowered. The children may only trade places when neither
+// has side effects
+size_t BinaryExpNode::regNeed(){
+	size_t need1 = myExp1->regNeed();
+	size_t need2 = myExp2->regNeed();
+	size_t held1 = myExp1->yieldsTmp() ? 1 : 0;
+	size_t held2 = myExp2->yieldsTmp() ? 1 : 0;
+	size_t need = std::max(need1, held1 + need2);
+	if (pure()){
+		need = std::min(need, std::max(need2, held2 + need1));
+	}
+	return std::max<size_t>(need, 1);
+}
+
+void BinaryExpNode::flattenChildren(Procedure * proc, 
+	Opd *& lhs, Opd *& rhs){
+	bool rightFirst = false;
+	if (proc->getProg()->compactTemps() && pure()){
+		size_t need1 = myExp1->regNeed();
+		size_t need2 = myExp2->regNeed();
+		size_t held1 = myExp1->yieldsTmp() ? 1 : 0;
+		size_t held2 = myExp2->yieldsTmp() ? 1 : 0;
+		rightFirst = std::max(need2, held2 + need1)
+			< std::max(need1, held1 + need2);
+	}
+	if (rightFirst){
+		rhs = myExp2->flatten(proc);
+		lhs = myExp1->flatten(proc);
+	} else {
+		lhs = myExp1->flatten(proc);
+		rhs = myExp2->flatten(proc);
+	}
+	//Only the quad about to be added reads them, so its result may
+	// take over either one
+	doneWith(proc, myExp1, lhs);
+	doneWith(proc, myExp2, rhs);
+}
+
+//The comparison that holds exactly when op does not
+static BinOp negateCompare(BinOp op){
+	switch (op){
+	case EQ: return NEQ;
+	case NEQ: return EQ;
+	case LT: return GTE;
+	case GTE: return LT;
+	case GT: return LTE;
+	case LTE: return GT;
+	default: throw new InternalError("Negated a non-comparison");
+	}
+}
+
+//A comparison in a condition needs no result of its own; the jump
+// tests it directly
+void BinaryExpNode::flattenCompare(Procedure * proc, BinOp op, 
+	Label * target, bool jumpIf){
+	Opd * op1;
+	Opd * op2;
+	flattenChildren(proc, op1, op2);
+	if (!jumpIf){ op = negateCompare(op); }
+	proc->addQuad(new JmpCmpQuad(op, op1, op2, target));
+}
+
+Opd * UnaryExpNode::flattenChild(Procedure * proc){
 	Opd * child = myExp->flatten(proc);
+	doneWith(proc, myExp, child);
+	return child;
+}
+
+Opd * NegNode::flatten(Procedure * proc){
+	Opd * child = flattenChild(proc);
 	OpdWidth width = QUADWORD;
 	Opd * dst = proc->makeTmp(width);
 	Quad * quad = new UnaryOpQuad(dst, NEG, child);
@@ -150,8 +268,12 @@ Opd * NegNode::flatten(Procedure * proc){
 	return dst;
 }
 
+void NotNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	myExp->flattenCond(proc, target, !jumpIf);
+}
+
 Opd * NotNode::flatten(Procedure * proc){
-	Opd * child = myExp->flatten(proc);
+	Opd * child = flattenChild(proc);
 	OpdWidth width = BYTE;
 	Opd * dst = proc->makeTmp(width);
 	Quad * quad = new UnaryOpQuad(dst, NOT, child);
@@ -160,8 +282,9 @@ Opd * NotNode::flatten(Procedure * proc){
 }
 
 Opd * PlusNode::flatten(Procedure * proc){
-	Opd * childL = myExp1->flatten(proc);
-	Opd * childR = myExp2->flatten(proc);
+	Opd * childL;
+	Opd * childR;
+	flattenChildren(proc, childL, childR);
 	OpdWidth width = QUADWORD;
 	Opd * dst = proc->makeTmp(width);
 	Quad * quad = new BinOpQuad(dst, ADD, childL, childR);
@@ -170,8 +293,9 @@ Opd * PlusNode::flatten(Procedure * proc){
 }
 
 Opd * MinusNode::flatten(Procedure * proc){
-	Opd * childL = myExp1->flatten(proc);
-	Opd * childR = myExp2->flatten(proc);
+	Opd * childL;
+	Opd * childR;
+	flattenChildren(proc, childL, childR);
 	OpdWidth width = QUADWORD;
 	Opd * dst = proc->makeTmp(width);
 	Quad * quad = new BinOpQuad(dst, SUB, childL, childR);
@@ -180,8 +304,9 @@ Opd * MinusNode::flatten(Procedure * proc){
 }
 
 Opd * TimesNode::flatten(Procedure * proc){
-	Opd * childL = myExp1->flatten(proc);
-	Opd * childR = myExp2->flatten(proc);
+	Opd * childL;
+	Opd * childR;
+	flattenChildren(proc, childL, childR);
 	OpdWidth width = QUADWORD;
 	Opd * dst = proc->makeTmp(width);
 	Quad * quad = new BinOpQuad(dst, MULT, childL, childR);
@@ -190,8 +315,9 @@ Opd * TimesNode::flatten(Procedure * proc){
 }
 
 Opd * DivideNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
+	Opd * op1;
+	Opd * op2;
+	flattenChildren(proc, op1, op2);
 	OpdWidth width = QUADWORD;
 	Opd * opRes = proc->makeTmp(width);
 	BinOpQuad * quad = new BinOpQuad(opRes, DIV, op1, op2);
@@ -199,29 +325,71 @@ Opd * DivideNode::flatten(Procedure * proc){
 	return opRes;
 }
 
+//The right side only runs when the left one does not settle the
+// result, which is then whatever the right side comes to
 Opd * AndNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
-	OpdWidth width = BYTE;
-	Opd * opRes = proc->makeTmp(width);
-	BinOpQuad * quad = new BinOpQuad(opRes, AND, op1, op2);
-	proc->addQuad(quad);
+	Opd * opRes = proc->makeTmp(BYTE);
+	Label * after = proc->makeLabel();
+	proc->addQuad(new AssignQuad(opRes, new LitOpd("0", BYTE)));
+	myExp1->flattenCond(proc, after, false);
+	Opd * op2 = myExp2->flatten(proc);
+	proc->addQuad(new AssignQuad(opRes, op2));
+	doneWith(proc, myExp2, op2);
+	addLabelNop(proc, after);
 	return opRes;
 }
 
 Opd * OrNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
-	OpdWidth width = BYTE;
-	Opd * opRes = proc->makeTmp(width);
-	BinOpQuad * quad = new BinOpQuad(opRes, OR, op1, op2);
-	proc->addQuad(quad);
+	Opd * opRes = proc->makeTmp(BYTE);
+	Label * after = proc->makeLabel();
+	proc->addQuad(new AssignQuad(opRes, new LitOpd("1", BYTE)));
+	myExp1->flattenCond(proc, after, true);
+	Opd * op2 = myExp2->flatten(proc);
+	proc->addQuad(new AssignQuad(opRes, op2));
+	doneWith(proc, myExp2, op2);
+	addLabelNop(proc, after);
 	return opRes;
 }
 
+//The result is held while either side is lowered
+size_t AndNode::regNeed(){
+	return std::max(myExp1->regNeed(), myExp2->regNeed()) + 1;
+}
+
+size_t OrNode::regNeed(){
+	return std::max(myExp1->regNeed(), myExp2->regNeed()) + 1;
+}
+
+//Both sides jump to target when it is false. When it is true, a
+// false left side skips the right one, which then decides
+void AndNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	if (!jumpIf){
+		myExp1->flattenCond(proc, target, false);
+		myExp2->flattenCond(proc, target, false);
+		return;
+	}
+	Label * skip = proc->makeLabel();
+	myExp1->flattenCond(proc, skip, false);
+	myExp2->flattenCond(proc, target, true);
+	addLabelNop(proc, skip);
+}
+
+void OrNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	if (jumpIf){
+		myExp1->flattenCond(proc, target, true);
+		myExp2->flattenCond(proc, target, true);
+		return;
+	}
+	Label * skip = proc->makeLabel();
+	myExp1->flattenCond(proc, skip, true);
+	myExp2->flattenCond(proc, target, false);
+	addLabelNop(proc, skip);
+}
+
 Opd * EqualsNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
+	Opd * op1;
+	Opd * op2;
+	flattenChildren(proc, op1, op2);
 	OpdWidth width = proc->getProg()->opWidth(this);
 	Opd * opRes = proc->makeTmp(width);
 	BinOpQuad * quad = new BinOpQuad(opRes, EQ, op1, op2);
@@ -229,9 +397,14 @@ Opd * EqualsNode::flatten(Procedure * proc){
 	return opRes;
 }
 
+void EqualsNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	flattenCompare(proc, EQ, target, jumpIf);
+}
+
 Opd * NotEqualsNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
+	Opd * op1;
+	Opd * op2;
+	flattenChildren(proc, op1, op2);
 	OpdWidth width = proc->getProg()->opWidth(this);
 	Opd * opRes = proc->makeTmp(width);
 	BinOpQuad * quad = new BinOpQuad(opRes, NEQ, op1, op2);
@@ -239,9 +412,14 @@ Opd * NotEqualsNode::flatten(Procedure * proc){
 	return opRes;
 }
 
+void NotEqualsNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	flattenCompare(proc, NEQ, target, jumpIf);
+}
+
 Opd * GreaterNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
+	Opd * op1;
+	Opd * op2;
+	flattenChildren(proc, op1, op2);
 	OpdWidth width = proc->getProg()->opWidth(this);
 	Opd * opRes = proc->makeTmp(width);
 	BinOpQuad * quad = new BinOpQuad(opRes, GT, op1, op2);
@@ -249,9 +427,14 @@ Opd * GreaterNode::flatten(Procedure * proc){
 	return opRes;
 }
 
+void GreaterNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	flattenCompare(proc, GT, target, jumpIf);
+}
+
 Opd * GreaterEqNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
+	Opd * op1;
+	Opd * op2;
+	flattenChildren(proc, op1, op2);
 	OpdWidth width = proc->getProg()->opWidth(this);
 	Opd * opRes = proc->makeTmp(width);
 	BinOpQuad * quad = new BinOpQuad(opRes, GTE, op1, op2);
@@ -259,9 +442,14 @@ Opd * GreaterEqNode::flatten(Procedure * proc){
 	return opRes;
 }
 
+void GreaterEqNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	flattenCompare(proc, GTE, target, jumpIf);
+}
+
 Opd * LessNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
+	Opd * op1;
+	Opd * op2;
+	flattenChildren(proc, op1, op2);
 	OpdWidth width = proc->getProg()->opWidth(this);
 	Opd * opRes = proc->makeTmp(width);
 	BinOpQuad * quad = new BinOpQuad(opRes, LT, op1, op2);
@@ -269,9 +457,14 @@ Opd * LessNode::flatten(Procedure * proc){
 	return opRes;
 }
 
+void LessNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	flattenCompare(proc, LT, target, jumpIf);
+}
+
 Opd * LessEqNode::flatten(Procedure * proc){
-	Opd * op1 = this->myExp1->flatten(proc);
-	Opd * op2 = this->myExp2->flatten(proc);
+	Opd * op1;
+	Opd * op2;
+	flattenChildren(proc, op1, op2);
 	OpdWidth width = proc->getProg()->opWidth(this);
 	Opd * opRes = proc->makeTmp(width);
 	BinOpQuad * quad = new BinOpQuad(opRes, LTE, op1, op2);
@@ -279,6 +472,10 @@ Opd * LessEqNode::flatten(Procedure * proc){
 	return opRes;
 }
 
+void LessEqNode::flattenCond(Procedure * proc, Label * target, bool jumpIf){
+	flattenCompare(proc, LTE, target, jumpIf);
+}
+
 void AssignStmtNode::to3AC(Procedure * proc){
 	Opd * res = myExp->flatten(proc);
 	// Since we're at the stmt level, we know
@@ -314,15 +511,15 @@ void ToConsoleStmtNode::to3AC(Procedure * proc){
 	IntrinsicOutputQuad * quad = new IntrinsicOutputQuad(child,
 		proc->getProg()->nodeType(mySrc));
 	proc->addQuad(quad);
+	doneWith(proc, mySrc, child);
 }
 
 void IfStmtNode::to3AC(Procedure * proc){
-	Opd * cond = myCond->flatten(proc);
 	Label * afterLabel = proc->makeLabel();
 	Quad * afterNop = new NopQuad();
 	afterNop->addLabel(afterLabel);
 
-	proc->addQuad(new JmpIfQuad(cond, afterLabel));
+	myCond->flattenCond(proc, afterLabel, false);
 	for (auto stmt : *myBody){
 		stmt->to3AC(proc);
 	}
@@ -337,10 +534,7 @@ void IfElseStmtNode::to3AC(Procedure * proc){
 	Quad * afterNop = new NopQuad();
 	afterNop->addLabel(afterLabel);
 
-	Opd * cond = myCond->flatten(proc);
-
-	Quad * jmpFalse = new JmpIfQuad(cond, elseLabel);
-	proc->addQuad(jmpFalse);
+	myCond->flattenCond(proc, elseLabel, false);
 	for (auto stmt : *myBodyTrue){
 		stmt->to3AC(proc);
 	}
@@ -367,9 +561,7 @@ void WhileStmtNode::to3AC(Procedure * proc){
 	afterQuad->addLabel(afterLabel);
 
 	proc->addQuad(headNop);
-	Opd * cond = myCond->flatten(proc);
-	Quad * jmpFalse = new JmpIfQuad(cond, afterLabel);
-	proc->addQuad(jmpFalse);
+	myCond->flattenCond(proc, afterLabel, false);
 
 	for (auto stmt : *myBody){
 		stmt->to3AC(proc);
@@ -388,6 +580,7 @@ void CallStmtNode::to3AC(Procedure * proc){
 	if (res != nullptr){
 		//A void call will not generate a getout
 		Quad * last = proc->popQuad();
+		proc->releaseTmp(res);
 	}
 	//Should probably delete the last quad, but
 	// we've leaked so much memory why start worrying now?
@@ -398,6 +591,7 @@ void ReturnStmtNode::to3AC(Procedure * proc){
 		Opd * res = myExp->flatten(proc);
 		Quad * setOut = new SetRetQuad(res);
 		proc->addQuad(setOut);
+		doneWith(proc, myExp, res);
 	}
 	
 	Label * leaveLbl = proc->getLeaveLabel();
@@ -5,9 +5,11 @@ namespace holeyc{
 Procedure::Procedure(IRProgram * prog, std::string name)
 : myProg(prog), myName(name){
 	maxTmp = 0;
+	frameSize = 0;
+	redZone = false;
 	enter = new EnterQuad(this);
 	leave = new LeaveQuad(this);
-	bodyQuads = new std::list<Quad *>();
+	quads = new QuadList();
 	if (myName.compare("main") == 0){
 		enter->addLabel(new Label("main"));
 	} else {
@@ -15,6 +17,8 @@ Procedure::Procedure(IRProgram * prog, std::string name)
 	}
 	leaveLabel = myProg->makeLabel();
 	leave->addLabel(leaveLabel);
+	quads->push_back(enter);
+	quads->push_back(leave);
 }
 
 std::string Procedure::getName(){
@@ -44,11 +48,29 @@ std::string Procedure::toString(bool verbose){
 	}
 	res += "[END " + this->getName() + " LOCALS]\n";
 
-	res += enter->toString(verbose) + "\n";
-	for (auto quad : *bodyQuads){
+	for (auto quad : *quads){
 		res += quad->toString(verbose) + "\n";
 	}
-	res += leave->toString(verbose) + "\n";
+	return res;
+}
+
+void Procedure::addStat(std::string name, size_t amount){
+	for (auto& stat : stats){
+		if (stat.first == name){
+			stat.second += amount;
+			return;
+		}
+	}
+	stats.push_back({name, amount});
+}
+
+std::string Procedure::statsString(){
+	std::string res = "";
+	res += "[BEGIN " + this->getName() + " STATS]\n";
+	for (auto stat : stats){
+		res += stat.first + " " + std::to_string(stat.second) + "\n";
+	}
+	res += "[END " + this->getName() + " STATS]\n";
 	return res;
 }
 
@@ -57,12 +79,13 @@ Label * Procedure::makeLabel(){
 }
 
 void Procedure::addQuad(Quad * quad){
-	bodyQuads->push_back(quad);
+	quads->insertBefore(leave, quad);
 }
 
 Quad * Procedure::popQuad(){
-	Quad * last = bodyQuads->back();
-	bodyQuads->pop_back();
+	Quad * last = leave->getPrev();
+	assert(last != enter);
+	quads->remove(last);
 	return last;
 }
 
@@ -92,6 +115,14 @@ SymOpd * Procedure::getSymOpd(SemSymbol * sym){
 }
 
 AuxOpd * Procedure::makeTmp(OpdWidth width){
+	for (auto itr = freeTemps.begin(); itr != freeTemps.end(); ++itr){
+		if ((*itr)->getWidth() == width){
+			AuxOpd * res = *itr;
+			freeTemps.erase(itr);
+			return res;
+		}
+	}
+
 	std::string name = "tmp";
 	name += std::to_string(maxTmp++);
 	AuxOpd * res = new AuxOpd(name, width);
@@ -100,16 +131,22 @@ AuxOpd * Procedure::makeTmp(OpdWidth width){
 	return res;
 }
 
+void Procedure::releaseTmp(Opd * opd){
+	if (!myProg->compactTemps()){ return; }
+	AuxOpd * tmp = dynamic_cast<AuxOpd *>(opd);
+	if (tmp == nullptr){
+		throw new InternalError("Released an operand that is not a temp");
+	}
+	//Most recently freed first, to keep reuse close together
+	freeTemps.push_front(tmp);
+}
+
 size_t Procedure::numTemps() const{
 	return this->temps.size();
 }
 
 size_t Procedure::arSize() const{
-	size_t size = 0;
-	for (auto local : locals){ size += 8; }
-	for (auto tmp : temps){ size += 8; }
-	for (auto formal : formals){ size += 8; }
-	return size;
+	return frameSize;
 }
 
 }
@@ -28,6 +28,7 @@ OpdWidth IRProgram::opDerefWidth(ASTNode * node){
 }
 
 Label * IRProgram::makeLabel(){
+	std::lock_guard<std::mutex> guard(counterLock);
 	Label * label = new Label("lbl_" + std::to_string(max_label++));
 	return label;
 }
@@ -46,6 +47,7 @@ void IRProgram::gatherGlobal(SemSymbol * sym){
 }
 
 Opd * IRProgram::makeString(std::string val){
+	std::lock_guard<std::mutex> guard(counterLock);
 	std::string name = "str_" + std::to_string(str_idx++);
 	AuxOpd * opd = new AuxOpd(name, ADDR);
 	strings[opd] = val;
@@ -72,6 +74,14 @@ std::string IRProgram::toString(bool verbose){
 	return res;
 }
 
+std::string IRProgram::statsString(){
+	std::string res = "";
+	for (Procedure * proc : *procs){
+		res += proc->statsString();
+	}
+	return res;
+}
+
 std::set<Opd *> IRProgram::globalSyms(){
 	std::set<Opd *> result;
 	for (auto gItr : globals){
@@ -80,4 +90,12 @@ std::set<Opd *> IRProgram::globalSyms(){
 	return result;
 }
 
+std::set<Opd *> IRProgram::stringSyms(){
+	std::set<Opd *> result;
+	for (auto entry : strings){
+		result.insert(entry.first);
+	}
+	return result;
+}
+
 }
@@ -1,15 +1,59 @@
 #include "3ac.hpp"
+#include "cfg.hpp"
 
 namespace holeyc{
 
 
-Quad::Quad() : myComment(""){
+Quad::Quad() : myComment(""), prev(nullptr), next(nullptr){
 }
 
 void Quad::addLabel(Label * label){
 	labels.push_back(label);
 }
 
+void QuadList::push_back(Quad * quad){
+	assert(quad->prev == nullptr && quad->next == nullptr);
+	quad->prev = tail;
+	if (tail == nullptr){
+		head = quad;
+	} else {
+		tail->next = quad;
+	}
+	tail = quad;
+}
+
+void QuadList::insertBefore(Quad * pos, Quad * quad){
+	assert(quad->prev == nullptr && quad->next == nullptr);
+	quad->next = pos;
+	quad->prev = pos->prev;
+	if (pos->prev == nullptr){
+		head = quad;
+	} else {
+		pos->prev->next = quad;
+	}
+	pos->prev = quad;
+}
+
+void QuadList::remove(Quad * quad){
+	if (quad->prev == nullptr){
+		head = quad->next;
+	} else {
+		quad->prev->next = quad->next;
+	}
+	if (quad->next == nullptr){
+		tail = quad->prev;
+	} else {
+		quad->next->prev = quad->prev;
+	}
+	quad->prev = nullptr;
+	quad->next = nullptr;
+}
+
+void QuadList::replace(Quad * oldQuad, Quad * newQuad){
+	insertBefore(oldQuad, newQuad);
+	remove(oldQuad);
+}
+
 void Quad::setComment(std::string commentIn){
 	this->myComment = commentIn;
 }
@@ -54,6 +98,7 @@ std::string Quad::toString(bool verbose){
 CallQuad::CallQuad(SemSymbol * calleeIn) : callee(calleeIn){ }
 
 std::string CallQuad::repr(){
+	if (isTail()){ return "tailcall " + callee->getName(); }
 	return "call " + callee->getName();
 }
 
@@ -82,61 +127,52 @@ BinOpQuad::BinOpQuad(Opd * dstIn, BinOp opIn, Opd * src1In, Opd * src2In)
 	assert(src2In != nullptr);
 }
 
-std::string BinOpQuad::repr(){
-	if (src2 == nullptr){
-		throw new InternalError("bino2 2 is null");
-	}
-	std::string opString;
+static std::string binOpString(BinOp op, Opd * src1){
 	switch (op){
 	case ADD:
-		opString = " ADD64 ";
-		break;
+		return " ADD64 ";
 	case SUB:
-		opString = " SUB64 ";
-		break;
+		return " SUB64 ";
 	case DIV:
-		opString = " DIV64 ";
-		break;
+		return " DIV64 ";
 	case MULT:
-		opString = " MULT64 ";
-		break;
+		return " MULT64 ";
 	case OR:
-		opString = " OR8 ";
-		break;
+		return " OR8 ";
 	case AND:
-		opString = " AND8 ";
-		break;
+		return " AND8 ";
 	case EQ:
 		if (src1->getWidth() == BYTE){
-			opString = " EQ8 ";
+			return " EQ8 ";
 		} else {
-			opString = " EQ64 ";
+			return " EQ64 ";
 		}
-		break;
 	case NEQ:
 		if (src1->getWidth() == BYTE){
-			opString = " NEQ8 ";
+			return " NEQ8 ";
 		} else {
-			opString = " NEQ64 ";
+			return " NEQ64 ";
 		}
-		break;
 	case LT:
-		opString = " LT64 ";
-		break;
+		return " LT64 ";
 	case GT:
-		opString = " GT64 ";
-		break;
+		return " GT64 ";
 	case LTE:
-		opString = " LTE64 ";
-		break;
+		return " LTE64 ";
 	case GTE:
-		opString = " GTE64 ";
-		break;
+		return " GTE64 ";
+	}
+	return "";
+}
+
+std::string BinOpQuad::repr(){
+	if (src2 == nullptr){
+		throw new InternalError("bino2 2 is null");
 	}
 	return dst->valString()
 		+ " := " 
 		+ src1->valString()
-		+ opString
+		+ binOpString(op, src1)
 		+ src2->valString();
 }
 
@@ -190,6 +226,17 @@ std::string JmpIfQuad::repr(){
 	return res;
 }
 
+JmpCmpQuad::JmpCmpQuad(BinOp opIn, Opd * src1In, Opd * src2In, 
+	Label * tgtIn) 
+: Quad(), op(opIn), src1(src1In), src2(src2In), tgt(tgtIn){ }
+
+std::string JmpCmpQuad::repr(){
+	return "IF " + src1->valString()
+		+ binOpString(op, src1)
+		+ src2->valString()
+		+ " GOTO " + tgt->toString();
+}
+
 NopQuad::NopQuad()
 : Quad() { }
 
@@ -197,6 +244,16 @@ std::string NopQuad::repr(){
 	return "nop";
 }
 
+std::string PhiQuad::repr(){
+	std::string res = dst->valString() + " := PHI(";
+	for (size_t idx = 0; idx < args.size(); idx++){
+		if (idx > 0){ res += ", "; }
+		res += args[idx].second->valString();
+		res += " blk" + std::to_string(args[idx].first->getNum());
+	}
+	return res + ")";
+}
+
 GetRetQuad::GetRetQuad(Opd * opdIn)
 : Quad(), opd(opdIn) { }
 
@@ -0,0 +1,99 @@
+#ifndef HOLEYC_BITVECTOR
+#define HOLEYC_BITVECTOR
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace holeyc{
+
+/**
+* A fixed-universe set of small integers packed into 64-bit words.
+* The set operations work a word at a time in straight loops over the
+* word arrays, which the compiler can vectorize. Vectors of different
+* sizes combine as if the shorter one were padded with zeros.
+**/
+class BitVector{
+public:
+	BitVector(){ }
+	explicit BitVector(size_t numBits)
+	: words((numBits + 63) / 64, 0){ }
+
+	void set(size_t bit){
+		growTo(bit / 64 + 1);
+		words[bit / 64] |= mask(bit);
+	}
+	void reset(size_t bit){
+		if (bit / 64 < words.size()){ words[bit / 64] &= ~mask(bit); }
+	}
+	bool test(size_t bit) const {
+		if (bit / 64 >= words.size()){ return false; }
+		return (words[bit / 64] & mask(bit)) != 0;
+	}
+
+	//this |= other, returning true if any bit was added
+	bool unionWith(const BitVector& other){
+		growTo(other.words.size());
+		uint64_t added = 0;
+		uint64_t * dst = words.data();
+		const uint64_t * src = other.words.data();
+		size_t n = other.words.size();
+		for (size_t i = 0; i < n; i++){
+			uint64_t merged = dst[i] | src[i];
+			added |= merged ^ dst[i];
+			dst[i] = merged;
+		}
+		return added != 0;
+	}
+
+	//this &= ~other
+	void subtract(const BitVector& other){
+		uint64_t * dst = words.data();
+		const uint64_t * src = other.words.data();
+		size_t n = std::min(words.size(), other.words.size());
+		for (size_t i = 0; i < n; i++){
+			dst[i] &= ~src[i];
+		}
+	}
+
+	//Call visit(bit) for each set bit, lowest first
+	template <typename Visitor>
+	void forEach(Visitor visit) const {
+		for (size_t w = 0; w < words.size(); w++){
+			uint64_t word = words[w];
+			while (word != 0){
+				size_t bit = static_cast<size_t>(__builtin_ctzll(word));
+				visit(w * 64 + bit);
+				word &= word - 1;
+			}
+		}
+	}
+
+	bool sameAs(const BitVector& other) const {
+		const std::vector<uint64_t>& shorter =
+			words.size() < other.words.size() ? words : other.words;
+		const std::vector<uint64_t>& longer =
+			words.size() < other.words.size() ? other.words : words;
+		uint64_t diff = 0;
+		for (size_t i = 0; i < shorter.size(); i++){
+			diff |= shorter[i] ^ longer[i];
+		}
+		for (size_t i = shorter.size(); i < longer.size(); i++){
+			diff |= longer[i];
+		}
+		return diff == 0;
+	}
+private:
+	static uint64_t mask(size_t bit){
+		return static_cast<uint64_t>(1) << (bit % 64);
+	}
+	void growTo(size_t numWords){
+		if (words.size() < numWords){ words.resize(numWords, 0); }
+	}
+
+	std::vector<uint64_t> words;
+};
+
+}
+
+#endif
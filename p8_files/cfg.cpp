@@ -1,11 +1,17 @@
 #include "3ac.hpp"
 #include "cfg.hpp"
+#include "cfg_loops.hpp"
 #include <set>
 #include <algorithm>
 #include <unordered_map>
 
 //#include "cfg_dce.hpp"
 #include "cfg_constants.hpp"
+#include "cfg_gvn.hpp"
+#include "cfg_licm.hpp"
+#include "cfg_ssa.hpp"
+#include "cfg_strength.hpp"
+#include "cfg_tail.hpp"
 
 using namespace holeyc;
 using namespace std;
@@ -15,7 +21,13 @@ ControlFlowGraph::ControlFlowGraph(CFGFactory * b){
 	exit = b->exitBlock;
 	entry = b->entryBlock;
 	blocks = b->blocks;
-	edges = b->edges;
+	for (BasicBlock * block : *blocks){
+		claimQuads(block);
+	}
+	for (CFGEdge * edge : *b->edges){
+		addEdge(edge->src, edge->tgt, edge->type);
+		delete edge;
+	}
 
 	assert(exit != nullptr);
 	assert(entry != nullptr);
@@ -40,89 +52,374 @@ BasicBlock * ControlFlowGraph::getExitBlock(){
 }
 
 void ControlFlowGraph::removeBlock(BasicBlock * block){
+	invalidateLoops();
 	blocks->remove(block);
 
-	for (Quad * quad : *block->getQuads()){
-		proc->getQuads()->remove(quad);
+	//Unlinking a quad clears its links, so step past it first
+	QuadList * procQuads = proc->getQuads();
+	Quad * quad = block->getLeader();
+	Quad * end = block->getTerminator()->getNext();
+	while (quad != end){
+		Quad * next = quad->getNext();
+		procQuads->remove(quad);
+		quadBlocks.erase(quad);
+		quad = next;
 	}
 
-	auto edgeItr = edges->begin();
-	while  (edgeItr != edges->end()){
-		auto edge = *edgeItr;
-		if (edge->src == block){
-			edgeItr = edges->erase(edgeItr);
-		} else if (edge->tgt == block){
-			edges->remove(edge);
-		} else {
-			edgeItr++;
-		}
+	while (!block->outEdges.empty()){
+		removeEdge(block->outEdges.back());
+	}
+	while (!block->inEdges.empty()){
+		removeEdge(block->inEdges.back());
 	}
 }
 
+CFGEdge * ControlFlowGraph::addEdge(BasicBlock * src, BasicBlock * tgt, 
+	CFGEdgeType type){
+	invalidateLoops();
+	CFGEdge * edge = new CFGEdge(src, tgt, type);
+	src->outEdges.push_back(edge);
+	tgt->inEdges.push_back(edge);
+	return edge;
+}
+
+static void eraseEdge(std::vector<CFGEdge *>& edges, CFGEdge * edge){
+	auto itr = std::find(edges.begin(), edges.end(), edge);
+	assert(itr != edges.end());
+	edges.erase(itr);
+}
+
+void ControlFlowGraph::removeEdge(CFGEdge * edge){
+	invalidateLoops();
+	eraseEdge(edge->src->outEdges, edge);
+	eraseEdge(edge->tgt->inEdges, edge);
+	delete edge;
+}
+
 BasicBlock * ControlFlowGraph::getBlock(Quad * quad){
+	auto found = quadBlocks.find(quad);
+	if (found == quadBlocks.end()){
+		return nullptr;
+	}
+	return found->second;
+}
+
+void ControlFlowGraph::claimQuads(BasicBlock * block){
+	for (Quad * quad : block->getQuads()){
+		quadBlocks[quad] = block;
+	}
+}
+
+std::list<BasicBlock *> * ControlFlowGraph::getBlocks(){ return blocks; }
+
+std::vector<BasicBlock *> ControlFlowGraph::reversePostorder(
+	bool withUnreachable){
+	std::vector<BasicBlock *> order;
+	std::unordered_map<BasicBlock *, bool> seen;
+	order.reserve(blocks->size());
+	seen.reserve(blocks->size());
+
+	//Iterative DFS; each stack entry remembers how many of the
+	// block's successors have been pushed so far
+	std::vector<std::pair<BasicBlock *, size_t>> stack;
+	stack.push_back({entry, 0});
+	seen[entry] = true;
+	while (!stack.empty()){
+		BasicBlock * block = stack.back().first;
+		size_t next = stack.back().second;
+		const std::vector<CFGEdge *>& outs = block->getOutEdges();
+		if (next < outs.size()){
+			stack.back().second++;
+			BasicBlock * succ = outs[next]->tgt;
+			if (!seen[succ]){
+				seen[succ] = true;
+				stack.push_back({succ, 0});
+			}
+		} else {
+			order.push_back(block);
+			stack.pop_back();
+		}
+	}
+	std::reverse(order.begin(), order.end());
+	if (!withUnreachable){ return order; }
+
+	//Unreachable blocks go last, in program order
 	for (BasicBlock * block : *blocks){
-		std::list<Quad *> * quads = block->getQuads();
-		auto qItr = std::find(quads->begin(), quads->end(), quad);
-		if (qItr != quads->end()){
-			return block;
+		if (!seen[block]){
+			order.push_back(block);
 		}
 	}
-	return nullptr;
+	return order;
 }
 
-std::list<BasicBlock *> * ControlFlowGraph::getBlocks(){ return blocks; }
+DominatorTree * ControlFlowGraph::getDominators(){
+	if (doms == nullptr){
+		doms = new DominatorTree(this);
+	}
+	return doms;
+}
 
-bool ControlFlowGraph::removeQuad(Quad * quad){
-	std::list<Quad *> * allQuads = proc->getQuads();
+LoopForest * ControlFlowGraph::getLoops(){
+	if (loops == nullptr){
+		loops = new LoopForest(this, *getDominators());
+	}
+	return loops;
+}
 
-	BasicBlock * block = getBlock(quad);
-	std::list<Quad *> * blockQuads = block->getQuads();
+void ControlFlowGraph::invalidateLoops(){
+	delete loops;
+	loops = nullptr;
+	delete doms;
+	doms = nullptr;
+}
 
-	if (blockQuads->size() == 1){
+bool ControlFlowGraph::removeQuad(Quad * quad){
+	BasicBlock * block = getBlock(quad);
+	if (block->getLeader() == block->getTerminator()){
 		return false;
 	}
 
-	allQuads->remove(quad);
-	blockQuads->remove(quad);
 	if (block->getLeader() == quad){
-		Label * lbl = quad->getLabel();
-
-		Quad * front = blockQuads->front();
-		front->clearLabels();
-		front->addLabel(lbl);
+		//The next quad is not a leader, so no jump uses its label
+		Quad * front = quad->getNext();
+		if (Label * lbl = quad->getLabel()){
+			front->clearLabels();
+			front->addLabel(lbl);
+		}
 		block->setLeader(front);
 	}
 	if (block->getTerminator() == quad){
-		block->setTerminator(blockQuads->back());
+		block->setTerminator(quad->getPrev());
 	}
+	proc->getQuads()->remove(quad);
+	quadBlocks.erase(quad);
 	return true;
 }
 
+void ControlFlowGraph::insertQuadBefore(Quad * pos, Quad * quad){
+	BasicBlock * block = getBlock(pos);
+	proc->getQuads()->insertBefore(pos, quad);
+	quadBlocks[quad] = block;
+	if (block->getLeader() == pos){
+		if (Label * label = pos->getLabel()){
+			quad->addLabel(label);
+			pos->clearLabels();
+		}
+		block->setLeader(quad);
+	}
+}
+
+void ControlFlowGraph::insertQuadAfter(Quad * pos, Quad * quad){
+	BasicBlock * block = getBlock(pos);
+	if (pos->getNext() == nullptr){
+		proc->getQuads()->push_back(quad);
+	} else {
+		proc->getQuads()->insertBefore(pos->getNext(), quad);
+	}
+	quadBlocks[quad] = block;
+	if (block->getTerminator() == pos){
+		block->setTerminator(quad);
+	}
+}
+
+void ControlFlowGraph::replaceQuad(Quad * oldQuad, Quad * newQuad){
+	BasicBlock * block = getBlock(oldQuad);
+	proc->getQuads()->replace(oldQuad, newQuad);
+	quadBlocks.erase(oldQuad);
+	quadBlocks[newQuad] = block;
+
+	if (Label * label = oldQuad->getLabel()){
+		newQuad->addLabel(label);
+	}
+	if (block->getLeader() == oldQuad){
+		block->setLeader(newQuad);
+	}
+	if (block->getTerminator() == oldQuad){
+		block->setTerminator(newQuad);
+	}
+}
+
 void ControlFlowGraph::replaceWithNop(Quad * quad){
-	NopQuad * nop = new NopQuad();
-	{
+	replaceQuad(quad, new NopQuad());
+}
+
+BasicBlock * ControlFlowGraph::splitBlock(Quad * quad){
 	BasicBlock * block = getBlock(quad);
-	std::list<Quad *> * blockQuads = block->getQuads();
-	auto pos = std::find(blockQuads->begin(), blockQuads->end(), quad);
-	blockQuads->insert(pos, nop);
-	blockQuads->erase(pos);
+	if (block->getLeader() == quad){ return block; }
 
-	if (block->getLeader() == quad){
-		block->setLeader(nop);
-		if (Label * label = quad->getLabel()){
-			nop->addLabel(label);
+	int num = 0;
+	for (BasicBlock * other : *blocks){
+		num = std::max(num, other->getNum() + 1);
+	}
+	BasicBlock * rest = new BasicBlock(num, quad, block->getTerminator());
+	block->setTerminator(quad->getPrev());
+	auto pos = std::find(blocks->begin(), blocks->end(), block);
+	blocks->insert(std::next(pos), rest);
+	claimQuads(rest);
+
+	std::vector<CFGEdge *> outs = block->getOutEdges();
+	for (CFGEdge * out : outs){
+		addEdge(rest, out->tgt, out->type);
+		removeEdge(out);
+	}
+	addEdge(block, rest, FALL);
+	if (block == exit){
+		exit = rest;
+	}
+	return rest;
+}
+
+bool ControlFlowGraph::removeUnreachableBlocks(){
+	std::vector<BasicBlock *> reached = reversePostorder(false);
+	std::set<BasicBlock *> live(reached.begin(), reached.end());
+	std::vector<BasicBlock *> dead;
+	for (BasicBlock * block : *blocks){
+		if (block != exit && live.count(block) == 0){
+			dead.push_back(block);
 		}
 	}
-	if (block->getTerminator() == quad){
-		block->setTerminator(nop);
+	for (BasicBlock * block : dead){
+		removeBlock(block);
+	}
+	return !dead.empty();
+}
+
+static void retarget(Quad * jmp, Label * label){
+	if (JmpQuad * gotoQuad = dynamic_cast<JmpQuad *>(jmp)){
+		gotoQuad->setTarget(label);
+	} else if (JmpIfQuad * ifzQuad = dynamic_cast<JmpIfQuad *>(jmp)){
+		ifzQuad->setTarget(label);
+	} else if (JmpCmpQuad * cmpQuad = dynamic_cast<JmpCmpQuad *>(jmp)){
+		cmpQuad->setTarget(label);
+	}
+}
+
+bool ControlFlowGraph::removeNops(){
+	size_t removed = 0;
+	std::vector<BasicBlock *> snapshot(blocks->begin(), blocks->end());
+	for (BasicBlock * block : snapshot){
+		std::vector<Quad *> nops;
+		for (Quad * quad : block->getQuads()){
+			if (dynamic_cast<NopQuad *>(quad)){ nops.push_back(quad); }
+		}
+		for (Quad * nop : nops){
+			if (removeQuad(nop) || bypassNopBlock(block)){
+				removed++;
+			}
+		}
 	}
+	proc->addStat("cleanup.nops", removed);
+	return removed > 0;
+}
+
+//A block holding a single nop falls through to the next block, so
+// every edge into it can go straight there instead. Jumps follow the
+// nop's label onto the next block's leader, or are retargeted to the
+// label that leader already has
+bool ControlFlowGraph::bypassNopBlock(BasicBlock * block){
+	if (block == entry || block == exit){ return false; }
+	if (block->getOutEdges().size() != 1){ return false; }
+	CFGEdge * out = block->getOutEdges().front();
+	BasicBlock * succ = out->tgt;
+	if (succ == block || out->type != FALL){ return false; }
+
+	if (Label * label = block->getLeader()->getLabel()){
+		Quad * succLeader = succ->getLeader();
+		if (Label * succLabel = succLeader->getLabel()){
+			for (CFGEdge * in : block->getInEdges()){
+				if (in->type == JUMP){
+					retarget(in->src->getTerminator(), succLabel);
+				}
+			}
+		} else {
+			succLeader->addLabel(label);
+		}
+	}
+
+	std::vector<CFGEdge *> ins = block->getInEdges();
+	for (CFGEdge * in : ins){
+		addEdge(in->src, succ, in->type);
+		removeEdge(in);
 	}
+	removeBlock(block);
+	return true;
+}
 
-	{
-	std::list<Quad *> * procQuads = proc->getQuads();
-	auto pos = std::find(procQuads->begin(), procQuads->end(), quad);
-	procQuads->insert(pos, nop);
-	procQuads->erase(pos);
+bool ControlFlowGraph::coalesceBlocks(){
+	size_t merged = 0;
+	std::unordered_map<BasicBlock *, bool> gone;
+	std::vector<BasicBlock *> snapshot(blocks->begin(), blocks->end());
+	for (BasicBlock * block : snapshot){
+		if (gone[block]){ continue; }
+		while (BasicBlock * succ = mergeCandidate(block)){
+			mergeBlocks(block, succ);
+			gone[succ] = true;
+			merged++;
+		}
+	}
+	proc->addStat("cleanup.merged", merged);
+	return merged > 0;
+}
+
+//The successor block of a single-edge block, if that successor has 
+// no other predecessor and can be placed right after the block. Calls
+// must stay at the end of their block, so LINK edges never merge, and
+// a successor that is not already next in the procedure can only be
+// moved up if it does not fall through to anything itself
+BasicBlock * ControlFlowGraph::mergeCandidate(BasicBlock * block){
+	if (block->getOutEdges().size() != 1){ return nullptr; }
+	CFGEdge * edge = block->getOutEdges().front();
+	BasicBlock * succ = edge->tgt;
+	if (succ == block || succ == entry){ return nullptr; }
+	if (succ->getInEdges().size() != 1 || edge->type == LINK){
+		return nullptr;
+	}
+
+	Quad * term = block->getTerminator();
+	if (term->getNext() == succ->getLeader()){ return succ; }
+	if (!dynamic_cast<JmpQuad *>(term)){ return nullptr; }
+	if (succ == exit || !dynamic_cast<JmpQuad *>(succ->getTerminator())){
+		return nullptr;
+	}
+	return succ;
+}
+
+void ControlFlowGraph::mergeBlocks(BasicBlock * block, BasicBlock * succ){
+	Quad * term = block->getTerminator();
+	QuadList * procQuads = proc->getQuads();
+	if (term->getNext() != succ->getLeader()){
+		Quad * pos = term;
+		Quad * quad = succ->getLeader();
+		Quad * end = succ->getTerminator()->getNext();
+		while (quad != end){
+			Quad * next = quad->getNext();
+			procQuads->remove(quad);
+			procQuads->insertBefore(pos->getNext(), quad);
+			pos = quad;
+			quad = next;
+		}
+	}
+
+	removeEdge(block->getOutEdges().front());
+	std::vector<CFGEdge *> outs = succ->getOutEdges();
+	for (CFGEdge * out : outs){
+		addEdge(block, out->tgt, out->type);
+		removeEdge(out);
+	}
+	for (Quad * quad : succ->getQuads()){
+		quadBlocks[quad] = block;
+	}
+	block->setTerminator(succ->getTerminator());
+	blocks->remove(succ);
+	if (succ == exit){
+		exit = block;
+	}
+
+	//The jump into succ is now a jump to the next quad. Only it
+	// referred to succ's label, so dropping it may leave that label
+	// unused, which is harmless
+	if (dynamic_cast<JmpQuad *>(term)){
+		removeQuad(term);
 	}
 }
 
@@ -137,27 +434,16 @@ void ControlFlowGraph::optimize(){
 	// bool dceEffect = DeadCodeElimination::run(this);
 
 	// TODO: implement this code
+	SSAConstruction::run(this);
 	bool constantEffect = ConstantsAnalysis::run(this);
-}
-
-std::set<BasicBlock *> ControlFlowGraph::blockSuccessors(BasicBlock * block){
-	std::set<BasicBlock *> res;
-	for (auto edge : *edges){
-		if (edge->src == block){
-			res.insert(edge->tgt);
-		}
-	}
-	return res;
-}
-
-std::set<BasicBlock *> ControlFlowGraph::blockPredecessors(BasicBlock * block){
-	std::set<BasicBlock *> res;
-	for (auto edge : *edges){
-		if (edge->tgt == block){
-			res.insert(edge->src);
-		}
-	}
-	return res;
+	//After folding, so factors that only became literals count too
+	StrengthReduction::run(this);
+	ValueNumbering::run(this);
+	LoopInvariantMotion::run(this);
+	SSADestruction::run(this);
+	TailCalls::run(this);
+	removeNops();
+	coalesceBlocks();
 }
 
 static void replaceAllSubstrs(std::string& str, std::string from, std::string to){
@@ -176,6 +462,9 @@ static void dottifyString(std::string& str){
 }
 
 void ControlFlowGraph::toDot(std::ostream& out){
+	DominatorTree * domTree = getDominators();
+	LoopForest * loopForest = getLoops();
+
 	out << "digraph G {\n";
 	for (auto block : *blocks){
 		out << "blk" << block->getNum() << " [";
@@ -183,29 +472,44 @@ void ControlFlowGraph::toDot(std::ostream& out){
 		dottifyString(res);
 		out << "shape=record ";
 		out << "label=\"" << res << "\"";
+		size_t depth = loopForest->depth(block);
+		if (depth > 0){
+			out << " xlabel=\"loop depth " << depth << "\"";
+		}
 		out << "]\n";
 	}
-	for (auto edge : *edges){
-		std::string srcNum = std::to_string(edge->src->getNum());
-		std::string tgtNum = std::to_string(edge->tgt->getNum());
-		std::string edgeLbl = "";
-		switch (edge->type){
-			case FALL:
+	for (auto block : *blocks){
+		for (auto edge : block->getOutEdges()){
+			std::string srcNum = std::to_string(edge->src->getNum());
+			std::string tgtNum = std::to_string(edge->tgt->getNum());
+			std::string edgeLbl = "";
+			switch (edge->type){
+				case FALL:
+					edgeLbl = "FALL";
+					break;
+				case JUMP:
+					edgeLbl = "JUMP";
+					break;
+				case LINK:
+					edgeLbl = "LINK";
+					break;
+			}
+			if (edge->type == FALL){
 				edgeLbl = "FALL";
-				break;
-			case JUMP:
-				edgeLbl = "JUMP";
-				break;
-			case LINK:
-				edgeLbl = "LINK";
-				break;
-		}
-		if (edge->type == FALL){
-			edgeLbl = "FALL";
-		} else {
+			} else {
+			}
+			out << "blk" << srcNum << " -> " << "blk" << tgtNum 
+			    << "[label=" << edgeLbl << "]" << "\n";
 		}
-		out << "blk" << srcNum << " -> " << "blk" << tgtNum 
-		    << "[label=" << edgeLbl << "]" << "\n";
+	}
+
+	//Dominator tree overlay; constraint=false keeps it from moving
+	// the blocks around
+	for (auto block : *blocks){
+		BasicBlock * dom = domTree->idom(block);
+		if (dom == nullptr){ continue; }
+		out << "blk" << dom->getNum() << " -> " << "blk" << block->getNum()
+		    << "[style=dashed color=blue constraint=false]" << "\n";
 	}
 
 	out << "}\n";
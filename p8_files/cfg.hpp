@@ -5,46 +5,102 @@
 #include <set>
 #include <algorithm>
 #include <unordered_map>
+#include <vector>
 
 namespace holeyc{
 
 class CFGFactory;
 class CFGEdge;
+class DominatorTree;
+class LoopForest;
 
 enum CFGEdgeType{
 	FALL, JUMP, LINK
 };
 
+class BasicBlock;
+
+class CFGEdge{
+public:
+	CFGEdge(BasicBlock * srcIn, BasicBlock * tgtIn, CFGEdgeType typeIn)
+	: src(srcIn), tgt(tgtIn), type(typeIn) {}
+	BasicBlock * src;
+	BasicBlock * tgt;
+	CFGEdgeType type;
+};
+
+/**
+* Iterates over the blocks at one end of a block's edge list, i.e. the
+* successors (edge targets) or predecessors (edge sources) of the block.
+* A block that is reached both by a jump and a fallthrough shows up once
+* per edge.
+**/
+class BlockRange{
+public:
+	typedef std::vector<CFGEdge *>::const_iterator EdgeItr;
+	class iterator{
+	public:
+		iterator(EdgeItr posIn, bool useSrcIn) 
+		: pos(posIn), useSrc(useSrcIn){ }
+		BasicBlock * operator*() const { 
+			return useSrc ? (*pos)->src : (*pos)->tgt;
+		}
+		iterator& operator++(){ ++pos; return *this; }
+		bool operator==(const iterator& other) const { 
+			return pos == other.pos; 
+		}
+		bool operator!=(const iterator& other) const { 
+			return pos != other.pos; 
+		}
+	private:
+		EdgeItr pos;
+		bool useSrc;
+	};
+
+	BlockRange(const std::vector<CFGEdge *>& edgesIn, bool useSrcIn)
+	: edges(edgesIn), useSrc(useSrcIn){ }
+	iterator begin() const { return iterator(edges.begin(), useSrc); }
+	iterator end() const { return iterator(edges.end(), useSrc); }
+	size_t size() const { return edges.size(); }
+	bool empty() const { return edges.empty(); }
+private:
+	const std::vector<CFGEdge *>& edges;
+	bool useSrc;
+};
+
 class BasicBlock{
 public:
-	BasicBlock(int numIn, std::list<Quad *> * quadsIn, Quad * leaderIn, Quad * terminatorIn) 
-	: num(numIn), quads(quadsIn), leader(leaderIn), terminator(terminatorIn){
+	BasicBlock(int numIn, Quad * leaderIn, Quad * terminatorIn) 
+	: num(numIn), leader(leaderIn), terminator(terminatorIn){
 	}
 	Quad * getLeader() { return leader; }
 	void setLeader(Quad * quad) { leader = quad; }
 	Quad * getTerminator() { return terminator; }
 	void setTerminator(Quad * quad) { terminator = quad; }
-	std::list<Quad *> * getQuads() { return quads; }
+	//The block's slice of the procedure's quad list
+	QuadRange getQuads() { return QuadRange(leader, terminator); }
 	std::string toString();
 	int getNum(){ return num; }
 
+	const std::vector<CFGEdge *>& getOutEdges(){ return outEdges; }
+	const std::vector<CFGEdge *>& getInEdges(){ return inEdges; }
+	BlockRange successors(){ return BlockRange(outEdges, false); }
+	BlockRange predecessors(){ return BlockRange(inEdges, true); }
+
 	void optimize();
 
 private:
 	const int num;
-	std::list<Quad *> * quads;
 	Quad * leader;
 	Quad * terminator;
 	std::string id;
-};
 
-class CFGEdge{
-public:
-	CFGEdge(BasicBlock * srcIn, BasicBlock * tgtIn, CFGEdgeType typeIn)
-	: src(srcIn), tgt(tgtIn), type(typeIn) {}
-	BasicBlock * src;
-	BasicBlock * tgt;
-	CFGEdgeType type;
+	//Edges are owned by the graph; both endpoints list every edge 
+	// between them so adjacency is available without a graph scan
+	std::vector<CFGEdge *> outEdges;
+	std::vector<CFGEdge *> inEdges;
+
+friend ControlFlowGraph;
 };
 
 class ControlFlowGraph{
@@ -56,27 +112,113 @@ public:
 	BasicBlock * getExitBlock();
 	BasicBlock * getBlock(Quad * quad);
 	std::list<BasicBlock *> * getBlocks();
+	std::vector<BasicBlock *> reversePostorder(bool withUnreachable = true);
 	void toDot(std::ostream& out);
 	Procedure * getProc(){ return proc; }
 	std::string getProcName();
 	void removeBlock(BasicBlock * block);
+	CFGEdge * addEdge(BasicBlock * src, BasicBlock * tgt, CFGEdgeType type);
+	void removeEdge(CFGEdge * edge);
 	bool removeQuad(Quad * quad);
+	//Add a quad to the block holding pos. Inserting before a leader
+	// makes the new quad the leader (and moves the label onto it);
+	// inserting after a terminator makes it the terminator
+	void insertQuadBefore(Quad * pos, Quad * quad);
+	void insertQuadAfter(Quad * pos, Quad * quad);
+	void replaceQuad(Quad * oldQuad, Quad * newQuad);
 	void replaceWithNop(Quad * quad);
-	void removeUnreachableBlocks();
+	//Start a new block at quad, right after the block that held it.
+	// The new block takes over the old one's out edges and the old
+	// block falls into it. A leader's own block is returned as is
+	BasicBlock * splitBlock(Quad * quad);
+	//Remove every block the entry cannot reach, other than the exit
+	bool removeUnreachableBlocks();
+	//Drop nops, moving their labels onto the next quad; a block that
+	// is nothing but a nop is bypassed and removed
+	bool removeNops();
+	//Merge each block into its predecessor when that is its only
+	// predecessor and the predecessor has no other successor
+	bool coalesceBlocks();
 	void cutJmpToNext();
-	std::set<BasicBlock *> blockSuccessors(BasicBlock * block);
-	std::set<BasicBlock *> blockPredecessors(BasicBlock * block);
+	BlockRange blockSuccessors(BasicBlock * block){
+		return block->successors();
+	}
+	BlockRange blockPredecessors(BasicBlock * block){
+		return block->predecessors();
+	}
+
+	//Built on first use and kept until the edges or blocks change
+	DominatorTree * getDominators();
+	LoopForest * getLoops();
 
 	void optimize();
 	void deadCodeElimination();
 private:
+	//Points every quad in the graph at the block that holds it.
+	// Anything that moves quads between blocks must re-claim them
+	void claimQuads(BasicBlock * block);
+	void invalidateLoops();
+	bool bypassNopBlock(BasicBlock * block);
+	BasicBlock * mergeCandidate(BasicBlock * block);
+	void mergeBlocks(BasicBlock * block, BasicBlock * succ);
+
 	std::list<BasicBlock *> * blocks;
-	std::list<CFGEdge *> * edges;
+	std::unordered_map<Quad *, BasicBlock *> quadBlocks;
 	BasicBlock * entry = nullptr;
 	BasicBlock * exit = nullptr;
 	Procedure * proc;
+	DominatorTree * doms = nullptr;
+	LoopForest * loops = nullptr;
 };
 
+//Replace each operand a quad reads with rename(operand)
+template <typename Rename>
+void renameUses(Quad * quad, Rename rename){
+	if (auto q = dynamic_cast<BinOpQuad *>(quad)){
+		q->setSrc1(rename(q->getSrc1()));
+		q->setSrc2(rename(q->getSrc2()));
+	} else if (auto q = dynamic_cast<UnaryOpQuad *>(quad)){
+		q->setSrc(rename(q->getSrc()));
+	} else if (auto q = dynamic_cast<AssignQuad *>(quad)){
+		q->setSrc(rename(q->getSrc()));
+	} else if (auto q = dynamic_cast<JmpIfQuad *>(quad)){
+		q->setCnd(rename(q->getCnd()));
+	} else if (auto q = dynamic_cast<JmpCmpQuad *>(quad)){
+		q->setSrc1(rename(q->getSrc1()));
+		q->setSrc2(rename(q->getSrc2()));
+	} else if (auto q = dynamic_cast<IntrinsicOutputQuad *>(quad)){
+		q->setSrc(rename(q->getSrc()));
+	} else if (auto q = dynamic_cast<SetArgQuad *>(quad)){
+		q->setSrc(rename(q->getSrc()));
+	} else if (auto q = dynamic_cast<SetRetQuad *>(quad)){
+		q->setSrc(rename(q->getSrc()));
+	} else if (auto q = dynamic_cast<PhiQuad *>(quad)){
+		for (size_t idx = 0; idx < q->numArgs(); idx++){
+			q->setArg(idx, rename(q->getArg(idx)));
+		}
+	}
+}
+
+//Replace the operand a quad writes (if any) with rename(operand)
+template <typename Rename>
+void renameDef(Quad * quad, Rename rename){
+	if (auto q = dynamic_cast<BinOpQuad *>(quad)){
+		q->setDst(rename(q->getDst()));
+	} else if (auto q = dynamic_cast<UnaryOpQuad *>(quad)){
+		q->setDst(rename(q->getDst()));
+	} else if (auto q = dynamic_cast<AssignQuad *>(quad)){
+		q->setDst(rename(q->getDst()));
+	} else if (auto q = dynamic_cast<IntrinsicInputQuad *>(quad)){
+		q->setDst(rename(q->getDst()));
+	} else if (auto q = dynamic_cast<GetArgQuad *>(quad)){
+		q->setDst(rename(q->getDst()));
+	} else if (auto q = dynamic_cast<GetRetQuad *>(quad)){
+		q->setDst(rename(q->getDst()));
+	} else if (auto q = dynamic_cast<PhiQuad *>(quad)){
+		q->setDst(rename(q->getDst()));
+	}
+}
+
 class CFGFactory{
 public:
 	static ControlFlowGraph * buildCFG(Procedure * procIn);
@@ -88,21 +230,30 @@ private:
 	void buildBlocks();
 	void buildCFGEdges();
 
-	std::unordered_map<Quad *, Quad *> jmpEdges;
-	std::unordered_map<Quad *, Quad *> fallthroughEdges;
-	std::unordered_map<Quad *, Quad *> linkEdges;
+	static const size_t NO_POS = static_cast<size_t>(-1);
+
+	//Quads in program order, enter first and leave last. A quad's
+	// index in this vector is its position for the rest of the build
+	std::vector<Quad *> quadSeq;
+	std::unordered_map<Label *, size_t> labelPos;
+
+	//Per-position edge info. The fallthrough and link targets are
+	// always the next position, so only the jump target is stored
+	std::vector<size_t> jmpTgts;
+	std::vector<bool> fallEdges;
+	std::vector<bool> linkEdges;
 
-	std::unordered_map<Quad *, Quad *> prevQuad;
-	std::unordered_map<Quad *, Quad *> nextQuad;
+	std::vector<bool> leaders;
+	std::vector<bool> terminators;
+
+	//Block starting at each leader position (nullptr elsewhere)
+	std::vector<BasicBlock *> blockAt;
 
 	std::list<CFGEdge *> * edges;
 	std::list<BasicBlock *> * blocks;
 	BasicBlock * entryBlock = nullptr;
 	BasicBlock * exitBlock = nullptr;
 
-	std::set<Quad *> leaders;
-	std::set<Quad *> terminators;
-
 	Procedure * proc;
 	
 friend ControlFlowGraph;
@@ -8,7 +8,7 @@ using namespace std;
 
 std::string BasicBlock::toString(){
 	std::string res = "";
-	for (auto quad : *quads){
+	for (auto quad : getQuads()){
 		res += quad->toString() + "\n";
 	}
 	return res;
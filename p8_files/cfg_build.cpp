@@ -5,6 +5,8 @@
 using namespace holeyc;
 using namespace std;
 
+const size_t CFGFactory::NO_POS;
+
 ControlFlowGraph * CFGFactory::buildCFG(Procedure * procIn){
 	CFGFactory f;
 	f.proc = procIn;
@@ -21,162 +23,160 @@ ControlFlowGraph * CFGFactory::buildCFG(Procedure * procIn){
 }
 
 void CFGFactory::sequenceQuads(){
-	EnterQuad * enter = proc->getEnter();
-	LeaveQuad * leave = proc->getLeave();
-
-	if (proc->getQuads()->empty()){
-		nextQuad.insert({enter,leave});
-		prevQuad.insert({leave,enter});
-		return;
+	for (auto quad : *proc->getQuads()){
+		quadSeq.push_back(quad);
 	}
+	assert(quadSeq.front() == proc->getEnter());
+	assert(quadSeq.back() == proc->getLeave());
 
-	Quad * trail = nullptr;
-	for (auto lead : *(proc->getQuads())){
-		if (trail == nullptr){
-			trail = lead;
-			nextQuad.insert({enter,lead});
-			prevQuad.insert({lead,enter});
-			continue;
+	labelPos.reserve(quadSeq.size());
+	for (size_t pos = 0; pos < quadSeq.size(); pos++){
+		if (Label * label = quadSeq[pos]->getLabel()){
+			labelPos[label] = pos;
 		}
-
-		nextQuad.insert({trail,lead});
-		prevQuad.insert({lead,trail});
-		trail = lead;
 	}
-	nextQuad.insert({trail,leave});
-	prevQuad.insert({leave,trail});
 }
 
 void CFGFactory::gatherQuadEdges(){
-	std::unordered_map<Label *, Quad *> labelToTgt;
-	Quad * quad = proc->getEnter();
-	while (true){
-		if (Label * label = quad->getLabel()){
-			labelToTgt[label] = quad;
-		}
-		if (quad == proc->getLeave()){ break; }
-		quad = nextQuad[quad];
-	}
-
-	quad = proc->getEnter();
-	while (true){
+	size_t numQuads = quadSeq.size();
+	jmpTgts.assign(numQuads, NO_POS);
+	fallEdges.assign(numQuads, false);
+	linkEdges.assign(numQuads, false);
+
+	size_t last = numQuads - 1;
+	for (size_t pos = 0; pos < numQuads; pos++){
+		Quad * quad = quadSeq[pos];
+		Label * tgtLabel = nullptr;
 		if (JmpQuad * gotoQuad = dynamic_cast<JmpQuad*>(quad)){
-			Quad * tgt = labelToTgt[gotoQuad->getLabel()];
-			jmpEdges.insert({gotoQuad, tgt});
+			tgtLabel = gotoQuad->getLabel();
 		} else if (JmpIfQuad * ifzQuad = dynamic_cast<JmpIfQuad*>(quad)){
-			Quad * tgt = labelToTgt[ifzQuad->getLabel()];
-			jmpEdges.insert({ifzQuad, tgt});
-			fallthroughEdges.insert({quad,nextQuad[quad]});
-		} else if (auto q = dynamic_cast<CallQuad *>(quad)){
-			linkEdges.insert({quad, nextQuad[quad]});
+			tgtLabel = ifzQuad->getLabel();
+			fallEdges[pos] = pos != last;
+		} else if (JmpCmpQuad * cmpQuad = dynamic_cast<JmpCmpQuad*>(quad)){
+			tgtLabel = cmpQuad->getLabel();
+			fallEdges[pos] = pos != last;
+		} else if (dynamic_cast<CallQuad *>(quad)){
+			linkEdges[pos] = pos != last;
 		} else {
-			fallthroughEdges.insert({quad,nextQuad[quad]});
+			fallEdges[pos] = pos != last;
+		}
+
+		if (tgtLabel != nullptr){
+			auto found = labelPos.find(tgtLabel);
+			if (found == labelPos.end()){
+				std::string msg = "Jump to unplaced label ";
+				msg += tgtLabel->toString();
+				throw new InternalError(msg.c_str());
+			}
+			jmpTgts[pos] = found->second;
 		}
-		if (quad == proc->getLeave()){ break; }
-		quad = nextQuad[quad];
 	}
 }
 
 void CFGFactory::markLeadersAndTerminators(){
-	leaders.insert(proc->getEnter());
-	terminators.insert(proc->getLeave());
-	for (auto edge : jmpEdges){
-		auto src = edge.first;
-		auto tgt = edge.second;
-		terminators.insert(src);
-		leaders.insert(nextQuad[src]);
-
-		leaders.insert(tgt);
-		terminators.insert(prevQuad[tgt]);
-
-		auto jmpFall = fallthroughEdges.find(src);
-		if (jmpFall != fallthroughEdges.end()){
-			auto jmpFallTgt = jmpFall->second;
-			leaders.insert(jmpFallTgt);
+	size_t numQuads = quadSeq.size();
+	leaders.assign(numQuads, false);
+	terminators.assign(numQuads, false);
+
+	leaders[0] = true;
+	terminators[numQuads - 1] = true;
+	for (size_t pos = 0; pos < numQuads; pos++){
+		size_t tgt = jmpTgts[pos];
+		if (tgt != NO_POS){
+			terminators[pos] = true;
+			leaders[tgt] = true;
+			if (tgt > 0){ terminators[tgt - 1] = true; }
+		} else if (linkEdges[pos]){
+			terminators[pos] = true;
 		}
 	}
-	for (auto edge : linkEdges){
-		auto src = edge.first;
-		auto tgt = edge.second;
-		terminators.insert(src);
-		leaders.insert(tgt);
-	}
 
-	Quad * quad = proc->getEnter();
-	while (quad != proc->getLeave()){
-		if (std::find(leaders.begin(), leaders.end(), quad) != leaders.end()){
-			terminators.insert(prevQuad[quad]);
-		}
-		if (std::find(terminators.begin(), terminators.end(), quad) != terminators.end()){
-			leaders.insert(nextQuad[quad]);
+	//Close the two marks under each other: a leader ends the
+	// previous block and a terminator starts the next one
+	for (size_t pos = 0; pos + 1 < numQuads; pos++){
+		if (leaders[pos + 1] || terminators[pos]){
+			terminators[pos] = true;
+			leaders[pos + 1] = true;
 		}
-		quad = nextQuad[quad];
 	}
 }
 
 void CFGFactory::buildBlocks(){
 	this->entryBlock = nullptr;
 	this->exitBlock = nullptr;
-	Quad * quad = proc->getEnter();
-	std::list<Quad *> * blockQuads = nullptr;
 	blocks = new std::list<BasicBlock *>();
-	
-	Quad * leader = nullptr;
-	Quad * terminator = nullptr;
+	blockAt.assign(quadSeq.size(), nullptr);
+
+	size_t leavePos = quadSeq.size() - 1;
+	bool inBlock = false;
+	size_t leaderPos = 0;
 	int num = 1;
-	while(quad != proc->getLeave()){
-		if (std::find(leaders.begin(), leaders.end(), quad) != leaders.end()){
-			blockQuads = new std::list<Quad *>();
-			leader = quad;
+	for (size_t pos = 0; pos < leavePos; pos++){
+		Quad * quad = quadSeq[pos];
+		if (leaders[pos]){
+			inBlock = true;
+			leaderPos = pos;
 		}
-		blockQuads->push_back(quad);
-		if (std::find(terminators.begin(), terminators.end(), quad) != terminators.end()){
-			terminator = quad;
-			BasicBlock * block = new BasicBlock(num++, blockQuads, leader, terminator);
+		if (terminators[pos]){
+			BasicBlock * block = new BasicBlock(num++, 
+				quadSeq[leaderPos], quad);
 			if (entryBlock == nullptr){
 				entryBlock = block;
 			}
 			blocks->push_back(block);
-			blockQuads = nullptr;
+			blockAt[leaderPos] = block;
+			inBlock = false;
 		}
-
-		quad = nextQuad[quad];
 	}
-	terminator = proc->getLeave();
-	if (blockQuads == nullptr){ 
-		leader = terminator;
-		blockQuads = new std::list<Quad *>(); 
+
+	//The leave quad always ends the exit block. It only starts it
+	// if the quad before it ended a block of its own
+	if (!inBlock){ 
+		leaderPos = leavePos;
 	}
-	blockQuads->push_back(terminator);
-	exitBlock = new BasicBlock(num++, blockQuads, leader, terminator);
+	Quad * leave = quadSeq[leavePos];
+	exitBlock = new BasicBlock(num++, quadSeq[leaderPos], leave);
 	if (entryBlock == nullptr){
 		entryBlock = exitBlock;
 	}
 	blocks->push_back(exitBlock);
+	blockAt[leaderPos] = exitBlock;
 }
 
 void CFGFactory::buildCFGEdges(){
 	edges = new std::list<CFGEdge *>();
+	size_t lastPos = 0;
 	for (auto srcBlock : *blocks){
-		auto srcQuad = srcBlock->getTerminator();
-		auto jmpEdge = jmpEdges.find(srcQuad);
-		auto fallEdge = fallthroughEdges.find(srcQuad);
-		auto linkEdge = linkEdges.find(srcQuad);
-		
-		for (auto tgtBlock : *blocks){
-			auto tgtQuad = tgtBlock->getLeader();
-			if (jmpEdge != jmpEdges.end() && jmpEdge->second == tgtQuad){
-				CFGEdge * edge = new CFGEdge(srcBlock, tgtBlock, JUMP);
-				edges->push_back(edge);
-			}
-			if (fallEdge != fallthroughEdges.end() && fallEdge->second == tgtQuad){
-				CFGEdge * edge = new CFGEdge(srcBlock, tgtBlock, FALL);
-				edges->push_back(edge);
-			}
-			if (linkEdge != linkEdges.end() && linkEdge->second == tgtQuad){
-				CFGEdge * edge = new CFGEdge(srcBlock, tgtBlock, LINK);
-				edges->push_back(edge);
-			}
+		//Blocks are built in program order, so the terminator of
+		// this block is the first terminator after the previous one
+		size_t termPos = lastPos;
+		while (quadSeq[termPos] != srcBlock->getTerminator()){
+			termPos++;
+		}
+		lastPos = termPos + 1;
+
+		BasicBlock * jmpTgt = nullptr;
+		if (jmpTgts[termPos] != NO_POS){
+			jmpTgt = blockAt[jmpTgts[termPos]];
+		}
+		BasicBlock * nextTgt = nullptr;
+		if (fallEdges[termPos] || linkEdges[termPos]){
+			nextTgt = blockAt[termPos + 1];
+		}
+		CFGEdgeType nextType = linkEdges[termPos] ? LINK : FALL;
+
+		//Emit edges ordered by target block number, jumps first on
+		// a tie, so the edge list reads the same as a block scan
+		if (nextTgt != nullptr && jmpTgt != nullptr 
+		    && nextTgt->getNum() < jmpTgt->getNum()){
+			edges->push_back(new CFGEdge(srcBlock, nextTgt, nextType));
+			nextTgt = nullptr;
+		}
+		if (jmpTgt != nullptr){
+			edges->push_back(new CFGEdge(srcBlock, jmpTgt, JUMP));
+		}
+		if (nextTgt != nullptr){
+			edges->push_back(new CFGEdge(srcBlock, nextTgt, nextType));
 		}
 	}
 }
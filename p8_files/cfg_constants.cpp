@@ -1,106 +1,385 @@
+#include <climits>
 #include "cfg_constants.hpp"
+#include "cfg_dce.hpp"
 
 using namespace holeyc;
 
-bool ConstantsAnalysis::runGraph(ControlFlowGraph *cfg)
-{
-	//This function should iterate over each block, much like the
-	// dead code elimination pass. However, constant propagation
-	// is a FORWARD analysis, so the inFacts will be made up
-	// of the union of PREDECESSORS, rather than the union of SUCCESSORS
-	// std::list<Quad *> *quads = block->getQuads();
-
-	bool changed = true;
-	for (BasicBlock *block : *cfg->getBlocks())
-	{
-		ConstantsFacts empty;
-		inFacts[block] = empty;
-		outFacts[block] = empty;
-	}
-	IRProgram *prog = cfg->getProc()->getProg();
-	std::set<Opd *> globalSyms = prog->globalSyms();
-
-	while (changed)
-	{
-		changed = false;
-		for (BasicBlock *block : *cfg->getBlocks())
-		{
-			ConstantsFacts in = inFacts[block];
-			for (BasicBlock *block : cfg->blockPredecessors(block))
-			{
-				in.addFacts(outFacts[block]);
+static bool litVal(Opd * opd, ConstantVal& res){
+	LitOpd * lit = dynamic_cast<LitOpd *>(opd);
+	if (lit == nullptr){ return false; }
+	long val = std::stol(lit->valString());
+	if (lit->getWidth() == BYTE){
+		res.setChar(static_cast<char>(val));
+	} else {
+		res.setInt(val);
+	}
+	return true;
+}
+
+static long wrapAdd(long a, long b){
+	return static_cast<long>(static_cast<unsigned long>(a) 
+		+ static_cast<unsigned long>(b));
+}
+
+static long wrapSub(long a, long b){
+	return static_cast<long>(static_cast<unsigned long>(a) 
+		- static_cast<unsigned long>(b));
+}
+
+static long wrapMult(long a, long b){
+	return static_cast<long>(static_cast<unsigned long>(a) 
+		* static_cast<unsigned long>(b));
+}
+
+static bool foldBinOp(BinOp op, ConstantVal l, ConstantVal r, 
+	ConstantVal& res){
+	long a = l.numVal();
+	long b = r.numVal();
+	switch (op){
+	case ADD: res.setInt(wrapAdd(a, b)); return true;
+	case SUB: res.setInt(wrapSub(a, b)); return true;
+	case MULT: res.setInt(wrapMult(a, b)); return true;
+	case DIV:
+		//Leave faulting divisions for the program to hit at runtime
+		if (b == 0 || (b == -1 && a == LONG_MIN)){ return false; }
+		res.setInt(a / b); 
+		return true;
+	case OR: res.setBool(a != 0 || b != 0); return true;
+	case AND: res.setBool(a != 0 && b != 0); return true;
+	case EQ: res.setBool(a == b); return true;
+	case NEQ: res.setBool(a != b); return true;
+	case LT: res.setBool(a < b); return true;
+	case GT: res.setBool(a > b); return true;
+	case LTE: res.setBool(a <= b); return true;
+	case GTE: res.setBool(a >= b); return true;
+	}
+	return false;
+}
+
+static bool foldUnaryOp(UnaryOp op, ConstantVal v, ConstantVal& res){
+	switch (op){
+	case NEG: res.setInt(wrapSub(0, v.numVal())); return true;
+	case NOT: res.setBool(v.numVal() == 0); return true;
+	}
+	return false;
+}
+
+bool ConstantsAnalysis::runGraph(){
+	globals = cfg->getProc()->getProg()->globalSyms();
+	findUses();
+
+	BasicBlock * entry = cfg->getEntryBlock();
+	reached.insert(entry);
+	visitBlock(entry);
+	while (!flowWork.empty() || !ssaWork.empty()){
+		while (!flowWork.empty()){
+			BasicBlock * block = flowWork.back()->tgt;
+			flowWork.pop_back();
+			if (reached.insert(block).second){
+				visitBlock(block);
+				continue;
 			}
-			in.gen(globalSyms);
-			inFacts[block] = in;
-			bool blockChange = runBlock(cfg, block);
-			if (blockChange)
-			{
-				changed = true;
+			//Only the phis can see the new edge
+			for (Quad * quad : block->getQuads()){
+				if (!dynamic_cast<PhiQuad *>(quad)){ break; }
+				visitQuad(quad);
 			}
 		}
-	}
-	return effectful;
-}
-
-bool ConstantsAnalysis::runBlock(ControlFlowGraph *cfg, BasicBlock *block)
-{
-	//This function should iterate over each quad in the block,
-	// much like the dead code elimination pass, except that this
-	// is a forward analysis, so you should iterate over the block
-	// from the first quad to the last, collecting the known constants
-
-	// There are two things you should do for each quad:
-	// 1) Constant Folding
-	// if all source operands are constants (i.e. can cast to LitOpd),
-	// evaluate the result and replace the quad with a simple assignment
-	// 2) Constant Propagation
-	// if the source operand of an assignment is a constant, record
-	// that fact and keep rolling
-	// if the source operand is a variable (SymOpd or AuxOpd), but that
-	// variable is known to be constant, replace the
-
-	auto quads = block->getQuads();
-
-	bool effectful = false;
-	auto quadItr = quads->begin();
-	std::map<std::string, std::string> constants;
-
-	while (quadItr != quads->end())
-	{
-		auto quad = *quadItr;
-		std::cout << quad->toString() << "\n";
-		if (auto q = dynamic_cast<AssignQuad *>(quad))
-		{
-			auto src = q->getSrc();
-			auto dst = q->getDst();
-
-			if (auto l = dynamic_cast<LitOpd *>(src))
-			{
-				constants[dst->valString()] = src->valString();
-				Opd *res = new LitOpd(l->valString(), QUADWORD);
-				q->setDst(res);
+		while (!ssaWork.empty()){
+			Quad * quad = ssaWork.back();
+			ssaWork.pop_back();
+			if (reached.count(cfg->getBlock(quad)) > 0){
+				visitQuad(quad);
 			}
-			if (auto l = dynamic_cast<SymOpd *>(src))
-			{
-				if (constants.count(src->valString()) > 0)
-				{
-					Opd *res = new LitOpd(constants[src->valString()], QUADWORD);
-					q->setSrc(res);
-					effectful = true;
+		}
+	}
+
+	//Predecessors go first, so a block whose only way in is from one
+	// other block can pick up where that block left off
+	std::unordered_map<BasicBlock *, std::map<Opd *, ConstantVal>> stores;
+	for (BasicBlock * block : cfg->reversePostorder(false)){
+		if (reached.count(block) == 0){ continue; }
+		std::map<Opd *, ConstantVal>& stored = stores[block];
+		std::unordered_set<BasicBlock *> preds;
+		for (BasicBlock * pred : block->predecessors()){
+			preds.insert(pred);
+		}
+		BasicBlock * pred = preds.size() == 1 ? *preds.begin() : nullptr;
+		if (pred != nullptr && pred != block && stores.count(pred) > 0){
+			stored = stores[pred];
+		}
+		rewriteBlock(block, stored);
+		resolveBranch(block);
+	}
+	size_t before = cfg->getBlocks()->size();
+	cfg->removeUnreachableBlocks();
+	size_t pruned = before - cfg->getBlocks()->size();
+	dropDeadPhiArgs();
+
+	Procedure * proc = cfg->getProc();
+	proc->addStat("constants.visits", visits);
+	proc->addStat("constants.propagated", propagated);
+	proc->addStat("constants.folded", folded);
+	proc->addStat("constants.branches", branches);
+	proc->addStat("constants.pruned", pruned);
+	return propagated + folded + branches + pruned > 0;
+}
+
+void ConstantsAnalysis::findUses(){
+	std::vector<Opd *> reads;
+	std::vector<Opd *> writes;
+	for (BasicBlock * block : *cfg->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			DeadCodeElimination::getUseDef(quad, reads, writes);
+			for (Opd * opd : reads){
+				if (dynamic_cast<SSAOpd *>(opd)){
+					uses[opd].push_back(quad);
 				}
 			}
-			if (auto l = dynamic_cast<AuxOpd *>(src))
-			{
-				if (constants.count(src->valString()) > 0)
-				{
-					Opd *res = new LitOpd(constants[src->valString()], QUADWORD);
-					q->setSrc(res);
-					effectful = true;
-				}
+		}
+	}
+}
+
+void ConstantsAnalysis::markEdge(CFGEdge * edge){
+	if (liveEdges.insert(edge).second){
+		flowWork.push_back(edge);
+	}
+}
+
+bool ConstantsAnalysis::edgeLive(BasicBlock * pred, BasicBlock * block){
+	for (CFGEdge * in : block->getInEdges()){
+		if (in->src == pred && liveEdges.count(in) > 0){ return true; }
+	}
+	return false;
+}
+
+void ConstantsAnalysis::visitBlock(BasicBlock * block){
+	for (Quad * quad : block->getQuads()){
+		visitQuad(quad);
+	}
+	//A conditional jump picks its edges itself, once its condition
+	// is known
+	Quad * term = block->getTerminator();
+	if (!dynamic_cast<JmpIfQuad *>(term) 
+	    && !dynamic_cast<JmpCmpQuad *>(term)){
+		for (CFGEdge * out : block->getOutEdges()){
+			markEdge(out);
+		}
+	}
+}
+
+void ConstantsAnalysis::visitQuad(Quad * quad){
+	visits++;
+	ConstantVal l, r, res;
+	if (auto q = dynamic_cast<PhiQuad *>(quad)){
+		BasicBlock * block = cfg->getBlock(q);
+		for (size_t idx = 0; idx < q->numArgs(); idx++){
+			if (edgeLive(q->getPred(idx), block)){
+				res.merge(valueOf(q->getArg(idx)));
 			}
 		}
-		quadItr++;
+		lower(q->getDst(), res);
+	} else if (auto q = dynamic_cast<AssignQuad *>(quad)){
+		lower(q->getDst(), valueOf(q->getSrc()));
+	} else if (auto q = dynamic_cast<BinOpQuad *>(quad)){
+		l = valueOf(q->getSrc1());
+		r = valueOf(q->getSrc2());
+		if (l.type == UNDEFVAL || r.type == UNDEFVAL){ return; }
+		if (!l.isConst() || !r.isConst() 
+		    || !foldBinOp(q->getOp(), l, r, res)){
+			res.setTop();
+		}
+		lower(q->getDst(), res);
+	} else if (auto q = dynamic_cast<UnaryOpQuad *>(quad)){
+		l = valueOf(q->getSrc());
+		if (l.type == UNDEFVAL){ return; }
+		if (!l.isConst() || !foldUnaryOp(q->getOp(), l, res)){
+			res.setTop();
+		}
+		lower(q->getDst(), res);
+	} else if (auto q = dynamic_cast<JmpIfQuad *>(quad)){
+		//IFZ jumps when the condition is zero and falls through otherwise
+		ConstantVal cnd = valueOf(q->getCnd());
+		if (cnd.type == UNDEFVAL){ return; }
+		for (CFGEdge * out : cfg->getBlock(q)->getOutEdges()){
+			bool jumps = out->type == JUMP;
+			if (!cnd.isConst() || jumps == (cnd.numVal() == 0)){
+				markEdge(out);
+			}
+		}
+	} else if (auto q = dynamic_cast<JmpCmpQuad *>(quad)){
+		l = valueOf(q->getSrc1());
+		r = valueOf(q->getSrc2());
+		if (l.type == UNDEFVAL || r.type == UNDEFVAL){ return; }
+		bool known = l.isConst() && r.isConst() 
+			&& foldBinOp(q->getOp(), l, r, res);
+		for (CFGEdge * out : cfg->getBlock(q)->getOutEdges()){
+			bool jumps = out->type == JUMP;
+			if (!known || jumps == (res.numVal() != 0)){
+				markEdge(out);
+			}
+		}
+	} else {
+		//Whatever else a quad writes comes from outside the procedure
+		std::vector<Opd *> reads;
+		std::vector<Opd *> writes;
+		DeadCodeElimination::getUseDef(quad, reads, writes);
+		res.setTop();
+		for (Opd * opd : writes){
+			lower(opd, res);
+		}
 	}
+}
+
+void ConstantsAnalysis::lower(Opd * opd, ConstantVal val){
+	if (!dynamic_cast<SSAOpd *>(opd)){ return; }
+	ConstantVal& cur = vals[opd];
+	ConstantVal next = cur;
+	next.merge(val);
+	if (next.sameAs(cur)){ return; }
+	cur = next;
+	for (Quad * use : uses[opd]){
+		ssaWork.push_back(use);
+	}
+}
+
+//Literals are constants and SSA names have whatever they were given.
+// Anything else (a global, or a name no definition reaches) could hold
+// any value
+ConstantVal ConstantsAnalysis::valueOf(Opd * opd){
+	ConstantVal res;
+	if (litVal(opd, res)){ return res; }
+	if (dynamic_cast<SSAOpd *>(opd)){
+		auto found = vals.find(opd);
+		if (found != vals.end()){ return found->second; }
+		return res;
+	}
+	res.setTop();
+	return res;
+}
+
+//Turn reads of constants into literals and fold whatever that leaves
+// with only literal sources. stored holds the constants known to be in
+// globals, up to the next call, and is updated through the block
+void ConstantsAnalysis::rewriteBlock(BasicBlock * block, 
+	std::map<Opd *, ConstantVal>& stored){
+	auto propagate = [this, &stored](Opd * opd){
+		if (dynamic_cast<LitOpd *>(opd)){ return opd; }
+		ConstantVal val = valueOf(opd);
+		auto found = stored.find(opd);
+		if (found != stored.end()){ val = found->second; }
+		if (!val.isConst()){ return opd; }
+		propagated++;
+		Opd * lit = new LitOpd(std::to_string(val.numVal()), 
+			opd->getWidth());
+		return lit;
+	};
+
+	Quad * quad = block->getLeader();
+	while (true){
+		bool last = quad == block->getTerminator();
+		renameUses(quad, propagate);
+
+		ConstantVal l, r, res;
+		Opd * dst = nullptr;
+		if (auto q = dynamic_cast<BinOpQuad *>(quad)){
+			if (litVal(q->getSrc1(), l) && litVal(q->getSrc2(), r)
+			    && foldBinOp(q->getOp(), l, r, res)){
+				dst = q->getDst();
+			}
+		} else if (auto q = dynamic_cast<UnaryOpQuad *>(quad)){
+			if (litVal(q->getSrc(), l) && foldUnaryOp(q->getOp(), l, res)){
+				dst = q->getDst();
+			}
+		}
+		if (dst != nullptr){
+			std::string val = std::to_string(res.numVal());
+			Quad * assign = new AssignQuad(dst, 
+				new LitOpd(val, dst->getWidth()));
+			cfg->replaceQuad(quad, assign);
+			quad = assign;
+			folded++;
+		}
 
-	return effectful;
+		if (dynamic_cast<CallQuad *>(quad)){
+			//The callee may write any global
+			stored.clear();
+		}
+		//A fold that used a global's value can make an SSA name
+		// constant too, which holds wherever the name is read
+		std::vector<Opd *> reads;
+		std::vector<Opd *> writes;
+		DeadCodeElimination::getUseDef(quad, reads, writes);
+		for (Opd * opd : writes){
+			auto assign = dynamic_cast<AssignQuad *>(quad);
+			bool known = assign != nullptr 
+				&& litVal(assign->getSrc(), res);
+			if (dynamic_cast<SSAOpd *>(opd)){
+				if (known){ vals[opd] = res; }
+			} else if (globals.count(opd) == 0){
+				continue;
+			} else if (known){
+				stored[opd] = res;
+			} else {
+				stored.erase(opd);
+			}
+		}
+
+		if (last){ break; }
+		quad = quad->getNext();
+	}
+}
+
+void ConstantsAnalysis::resolveBranch(BasicBlock * block){
+	Quad * branch = block->getTerminator();
+	Label * target = nullptr;
+	bool jumps = false;
+	ConstantVal l, r, res;
+	if (auto jmpIf = dynamic_cast<JmpIfQuad *>(branch)){
+		if (!litVal(jmpIf->getCnd(), l)){ return; }
+		target = jmpIf->getLabel();
+		jumps = l.numVal() == 0;
+	} else if (auto jmpCmp = dynamic_cast<JmpCmpQuad *>(branch)){
+		if (!litVal(jmpCmp->getSrc1(), l) || !litVal(jmpCmp->getSrc2(), r)
+		    || !foldBinOp(jmpCmp->getOp(), l, r, res)){
+			return;
+		}
+		target = jmpCmp->getLabel();
+		jumps = res.numVal() != 0;
+	} else {
+		return;
+	}
+
+	std::vector<CFGEdge *> outs = block->getOutEdges();
+	for (CFGEdge * out : outs){
+		if ((out->type == JUMP) != jumps){
+			cfg->removeEdge(out);
+		}
+	}
+	if (jumps){
+		cfg->replaceQuad(branch, new JmpQuad(target));
+	} else {
+		cfg->replaceWithNop(branch);
+	}
+	branches++;
+}
+
+//A phi keeps only the arguments of predecessors that still have an
+// edge into its block
+void ConstantsAnalysis::dropDeadPhiArgs(){
+	for (BasicBlock * block : *cfg->getBlocks()){
+		std::unordered_set<BasicBlock *> preds;
+		for (BasicBlock * pred : block->predecessors()){
+			preds.insert(pred);
+		}
+		for (Quad * quad : block->getQuads()){
+			auto phi = dynamic_cast<PhiQuad *>(quad);
+			if (phi == nullptr){ break; }
+			for (size_t idx = phi->numArgs(); idx > 0; idx--){
+				if (preds.count(phi->getPred(idx - 1)) == 0){
+					phi->removeArg(idx - 1);
+				}
+			}
+		}
+	}
 }
@@ -2,88 +2,116 @@
 #define HOLEYC_CFG_CONSTANTS
 
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include "cfg.hpp"
 #include "3ac.hpp"
 
 namespace holeyc{
 
-enum ConstantValType {INTVAL, CHARVAL, BOOLVAL, TOPVAL};
+enum ConstantValType {UNDEFVAL, INTVAL, CHARVAL, BOOLVAL, TOPVAL};
 
 /**
-* This class represents the possible value that an Opd might take on at
-* at some program point. Note that if the Opd might take on more than 
-* one possible value at a program point, it is simply represented as
-* TOPVAL (regardless of what the values are). This use of TOPVAL causes the 
-* algorithm to reach saturation much faster. 
+* This class represents the possible value that an Opd might take on.
+* UNDEFVAL is the optimistic start: no definition of the Opd has been
+* found to run yet. A known constant carries its type. If the Opd
+* might take on more than one possible value (or one that cannot be
+* known), it is simply represented as TOPVAL (regardless of what the
+* values are). An Opd only ever moves from UNDEFVAL to a constant to
+* TOPVAL, so it can change at most twice.
 **/
 class ConstantVal{
 public:
+	ConstantVal() : type(UNDEFVAL), intVal(0), charVal(0), boolVal(false){}
 	ConstantValType type;
 
-	int intVal;
+	long intVal;
 	char charVal;
 	bool boolVal;
-	void setInt(int val){ intVal = val; type = INTVAL; } 
-	void setBool(bool val){ boolVal = val; type = BOOLVAL; } 
-	void setChar(char val){ charVal = val; type = CHARVAL; } 
-	void setTop(){ type = TOPVAL; } 
+	void setInt(long val){ intVal = val; type = INTVAL; }
+	void setBool(bool val){ boolVal = val; type = BOOLVAL; }
+	void setChar(char val){ charVal = val; type = CHARVAL; }
+	void setTop(){ type = TOPVAL; }
+	bool isConst() const { return type != UNDEFVAL && type != TOPVAL; }
 
-
-	void merge(ConstantVal other){
-		if (other.type == TOPVAL) {
-			setTop(); 
-		} else if (other.type == INTVAL) { 
-			if (intVal != other.intVal){ setTop(); }
-		} else if (other.type == CHARVAL) { 
-			if (charVal != other.charVal){ setTop(); }
-		} else if (other.type == BOOLVAL) { 
-			if (intVal != other.intVal){ setTop(); }
+	//The value as a machine integer, whatever its type
+	long numVal() const {
+		switch (type){
+		case INTVAL: return intVal;
+		case CHARVAL: return charVal;
+		case BOOLVAL: return boolVal ? 1 : 0;
+		case UNDEFVAL: break;
+		case TOPVAL: break;
 		}
+		return 0;
 	}
-};
 
-class ConstantsFacts{
-public:
-	ConstantsFacts(){}
-	ConstantsFacts clone(){
-		ConstantsFacts facts;
-		return facts;
+	bool sameAs(const ConstantVal& other) const {
+		if (type != other.type){ return false; }
+		if (!isConst()){ return true; }
+		return numVal() == other.numVal();
 	}
-	void addFacts(DeadCodeFacts& other){ this->gen(other.liveOpds); }
-	void gen(Opd * opd, ConstantVal v){
-		auto itr = vals.find(opd);
-		if (itr == vals.end()){
-			vals[opd] = v;
-		} else {
-			ConstantVal cur = itr->second;
-			
+
+	void merge(ConstantVal other){
+		if (other.type == UNDEFVAL){ return; }
+		if (type == UNDEFVAL){
+			*this = other;
+		} else if (!sameAs(other)){
+			setTop();
 		}
 	}
-	void kill(Opd * opd){
-		vals.erase(opd);
-	}
-	//TODO: You'll probably want to add some extra convenience functions
-	// to, for example, merge two constantsFacts objects, or determine if
-	// a given set of values changes a fact set to determine if you've reached
-	// saturation.
-private:
-	std::map<Opd *, ConstantVal> vals;
 };
 
+/**
+* Sparse conditional constant propagation (Wegman and Zadeck) over the
+* SSA form. Values flow along def-use chains, but only through quads in
+* blocks that some executable edge reaches. A conditional jump on a
+* known constant makes only the edge it takes executable, and a phi
+* only meets the arguments of its executable edges, so a constant can
+* get through a branch that would have spoiled it.
+*
+* Afterwards every read of a constant becomes a literal, operations
+* whose results are constant become assignments of them, conditional
+* jumps on constants become plain jumps or fallthroughs, and blocks no
+* executable edge reaches are removed. Globals are not in SSA form, so
+* constants stored to them are only followed up to the next call and
+* on into blocks that can only be entered from where they were stored.
+**/
 class ConstantsAnalysis{
 public:
 	static bool run(ControlFlowGraph * cfg){
-		ConstantsAnalysis ca;
-		return ca.runGraph(cfg);
+		ConstantsAnalysis ca(cfg);
+		return ca.runGraph();
 	}
 private:
-	ConstantsAnalysis() : effectful(false){}
-	bool runGraph(ControlFlowGraph * cfg); 
-	bool runBlock(ControlFlowGraph * cfg, BasicBlock * block); 
+	ConstantsAnalysis(ControlFlowGraph * cfgIn) : cfg(cfgIn){}
+	bool runGraph();
+	void findUses();
+	void markEdge(CFGEdge * edge);
+	bool edgeLive(BasicBlock * pred, BasicBlock * block);
+	void visitBlock(BasicBlock * block);
+	void visitQuad(Quad * quad);
+	void lower(Opd * opd, ConstantVal val);
+	ConstantVal valueOf(Opd * opd);
+	void rewriteBlock(BasicBlock * block, 
+		std::map<Opd *, ConstantVal>& stored);
+	void resolveBranch(BasicBlock * block);
+	void dropDeadPhiArgs();
+
+	ControlFlowGraph * cfg;
+	std::set<Opd *> globals;
+	//Values of the SSA names; a name with no entry is still UNDEFVAL
+	std::unordered_map<Opd *, ConstantVal> vals;
+	std::unordered_map<Opd *, std::vector<Quad *>> uses;
+	std::unordered_set<CFGEdge *> liveEdges;
+	std::unordered_set<BasicBlock *> reached;
+	std::vector<CFGEdge *> flowWork;
+	std::vector<Quad *> ssaWork;
 
-	std::map<BasicBlock *, ConstantsFacts> outFacts;
-	std::map<BasicBlock *, ConstantsFacts> inFacts;
-	bool effectful;
+	size_t visits = 0;
+	size_t propagated = 0;
+	size_t folded = 0;
+	size_t branches = 0;
 };
 
 }
@@ -0,0 +1,109 @@
+#ifndef HOLEYC_CFG_DATAFLOW
+#define HOLEYC_CFG_DATAFLOW
+
+#include <set>
+#include <vector>
+#include <unordered_map>
+#include "cfg.hpp"
+
+namespace holeyc{
+
+enum DataflowDirection{
+	FORWARD, BACKWARD
+};
+
+/**
+* Worklist solver for block-level dataflow problems over a
+* ControlFlowGraph. The Problem class describes the analysis:
+*
+*   typedef ... Fact;
+*      The lattice element attached to each block. A default-constructed
+*      Fact is the optimistic starting value of every block's output.
+*   static const DataflowDirection direction;
+*   void initFact(BasicBlock * block, Fact& fact);
+*      Reset fact to the value a block's input starts from before the
+*      outputs of its upstream neighbors are met into it (the boundary
+*      value for the entry or exit block, the meet identity otherwise).
+*   void meet(Fact& into, const Fact& from);
+*   bool transfer(BasicBlock * block, const Fact& in, Fact& out);
+*      Compute out from in, returning true if out changed.
+*
+* Blocks are visited in reverse postorder for forward problems and in
+* postorder for backward ones, and a block is only revisited when the
+* output of one of its upstream neighbors changed. For a forward problem
+* the input of a block is the fact at its top, for a backward problem
+* it is the fact at its bottom.
+**/
+template <typename Problem>
+class DataflowSolver{
+public:
+	typedef typename Problem::Fact Fact;
+
+	DataflowSolver(ControlFlowGraph * cfgIn, Problem& problemIn)
+	: cfg(cfgIn), problem(problemIn), visits(0){
+		order = cfg->reversePostorder();
+		if (Problem::direction == BACKWARD){
+			std::reverse(order.begin(), order.end());
+		}
+		for (size_t idx = 0; idx < order.size(); idx++){
+			position[order[idx]] = idx;
+		}
+		inFacts.resize(order.size());
+		outFacts.resize(order.size());
+	}
+
+	void solve(){
+		std::set<size_t> worklist;
+		for (size_t idx = 0; idx < order.size(); idx++){
+			worklist.insert(idx);
+		}
+		while (!worklist.empty()){
+			size_t idx = *worklist.begin();
+			worklist.erase(worklist.begin());
+			BasicBlock * block = order[idx];
+
+			Fact& in = inFacts[idx];
+			problem.initFact(block, in);
+			for (BasicBlock * up : upstream(block)){
+				problem.meet(in, outFacts[position[up]]);
+			}
+
+			visits++;
+			if (problem.transfer(block, in, outFacts[idx])){
+				for (BasicBlock * down : downstream(block)){
+					worklist.insert(position[down]);
+				}
+			}
+		}
+	}
+
+	Fact& inFact(BasicBlock * block){ return inFacts[position[block]]; }
+	Fact& outFact(BasicBlock * block){ return outFacts[position[block]]; }
+	size_t numVisits() const { return visits; }
+	size_t numBlocks() const { return order.size(); }
+private:
+	BlockRange upstream(BasicBlock * block){
+		if (Problem::direction == FORWARD){
+			return block->predecessors();
+		}
+		return block->successors();
+	}
+	BlockRange downstream(BasicBlock * block){
+		if (Problem::direction == FORWARD){
+			return block->successors();
+		}
+		return block->predecessors();
+	}
+
+	ControlFlowGraph * cfg;
+	Problem& problem;
+	std::vector<BasicBlock *> order;
+	std::unordered_map<BasicBlock *, size_t> position;
+	std::vector<Fact> inFacts;
+	std::vector<Fact> outFacts;
+	size_t visits;
+};
+
+}
+
+#endif
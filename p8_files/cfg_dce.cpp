@@ -4,33 +4,44 @@
 
 using namespace holeyc;
 
-static void getUseDef(Quad * quad, std::set<Opd *>& uses, std::set<Opd *>& defs){
+const size_t OpdNumbering::NO_OPD;
+
+void DeadCodeElimination::getUseDef(Quad * quad, 
+	std::vector<Opd *>& uses, std::vector<Opd *>& defs){
 	uses.clear();
 	defs.clear();
 	if (auto q = dynamic_cast<BinOpQuad *>(quad)){
-		uses.insert(q->getSrc1());
-		uses.insert(q->getSrc2());
-		defs.insert(q->getDst());
+		uses.push_back(q->getSrc1());
+		uses.push_back(q->getSrc2());
+		defs.push_back(q->getDst());
 	} else if (auto q = dynamic_cast<UnaryOpQuad *>(quad)){
-		uses.insert(q->getSrc());
-		defs.insert(q->getDst());
+		uses.push_back(q->getSrc());
+		defs.push_back(q->getDst());
 	} else if (auto q = dynamic_cast<AssignQuad *>(quad)){
-		uses.insert(q->getSrc());
-		defs.insert(q->getDst());
+		uses.push_back(q->getSrc());
+		defs.push_back(q->getDst());
 	} else if (auto q = dynamic_cast<JmpIfQuad *>(quad)){
-		uses.insert(q->getCnd());
+		uses.push_back(q->getCnd());
+	} else if (auto q = dynamic_cast<JmpCmpQuad *>(quad)){
+		uses.push_back(q->getSrc1());
+		uses.push_back(q->getSrc2());
 	} else if (auto q = dynamic_cast<IntrinsicOutputQuad *>(quad)){
-		uses.insert(q->getSrc());
+		uses.push_back(q->getSrc());
 	} else if (auto q = dynamic_cast<IntrinsicInputQuad *>(quad)){
-		defs.insert(q->getDst());
+		defs.push_back(q->getDst());
 	} else if (auto q = dynamic_cast<SetArgQuad *>(quad)){
-		uses.insert(q->getSrc());
+		uses.push_back(q->getSrc());
 	} else if (auto q = dynamic_cast<GetArgQuad *>(quad)){
-		defs.insert(q->getDst());
+		defs.push_back(q->getDst());
 	} else if (auto q = dynamic_cast<SetRetQuad *>(quad)){
-		defs.insert(q->getSrc());
+		uses.push_back(q->getSrc());
 	} else if (auto q = dynamic_cast<GetRetQuad *>(quad)){
-		defs.insert(q->getDst());
+		defs.push_back(q->getDst());
+	} else if (auto q = dynamic_cast<PhiQuad *>(quad)){
+		for (size_t idx = 0; idx < q->numArgs(); idx++){
+			uses.push_back(q->getArg(idx));
+		}
+		defs.push_back(q->getDst());
 	}
 }
 
@@ -43,6 +54,8 @@ bool DeadCodeElimination::immune(Quad * quad){
 		return true;
 	} else if (auto q = dynamic_cast<JmpIfQuad *>(quad)){
 		return true;
+	} else if (auto q = dynamic_cast<JmpCmpQuad *>(quad)){
+		return true;
 	} else if (auto q = dynamic_cast<SetArgQuad *>(quad)){
 		return true;
 	} else if (auto q = dynamic_cast<IntrinsicInputQuad *>(quad)){
@@ -59,26 +72,139 @@ bool DeadCodeElimination::immune(Quad * quad){
 	return false;
 }
 
-bool DeadCodeElimination::runBlock(ControlFlowGraph * cfg, BasicBlock * block){
-	std::list<Quad *> * quads = block->getQuads();
+OpdNumbering::OpdNumbering(ControlFlowGraph * cfg, 
+	const std::set<Opd *>& globals){
+	for (Opd * global : globals){
+		number(global);
+	}
+	std::vector<Opd *> uses;
+	std::vector<Opd *> defs;
+	for (BasicBlock * block : *cfg->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			DeadCodeElimination::getUseDef(quad, uses, defs);
+			for (Opd * opd : uses){ number(opd); }
+			for (Opd * opd : defs){ number(opd); }
+		}
+	}
 
-	auto quadItr = quads->rbegin();
-	DeadCodeFacts facts = this->inFacts[block];
-	std::set<Quad *> deadQuads;
-	while (quadItr != quads->rend()){
-		auto quad = *quadItr;
+	//Find the operands that are read before being written in some 
+	// block. defBlock stamps each operand with the last block that
+	// wrote it, so the scan needs no per-block set
+	std::vector<bool> crossing(opds.size(), false);
+	std::vector<BasicBlock *> defBlock(opds.size(), nullptr);
+	for (size_t idx = 0; idx < globals.size(); idx++){
+		crossing[idx] = true;
+	}
+	for (BasicBlock * block : *cfg->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			DeadCodeElimination::getUseDef(quad, uses, defs);
+			for (Opd * opd : uses){
+				size_t idx = index(opd);
+				if (idx != NO_OPD && defBlock[idx] != block){
+					crossing[idx] = true;
+				}
+			}
+			for (Opd * opd : defs){
+				defBlock[index(opd)] = block;
+			}
+		}
+	}
+
+	//Renumber so that the crossing operands come first
+	std::vector<Opd *> ordered;
+	ordered.reserve(opds.size());
+	for (size_t idx = 0; idx < opds.size(); idx++){
+		if (crossing[idx]){ ordered.push_back(opds[idx]); }
+	}
+	liveCount = ordered.size();
+	for (size_t idx = 0; idx < opds.size(); idx++){
+		if (!crossing[idx]){ ordered.push_back(opds[idx]); }
+	}
+	opds.swap(ordered);
+	for (size_t idx = 0; idx < opds.size(); idx++){
+		indices[opds[idx]] = idx;
+	}
+}
+
+void OpdNumbering::number(Opd * opd){
+	if (dynamic_cast<LitOpd *>(opd)){ return; }
+	if (indices.find(opd) != indices.end()){ return; }
+	indices[opd] = opds.size();
+	opds.push_back(opd);
+}
+
+LivenessProblem::LivenessProblem(ControlFlowGraph * cfg, 
+	const OpdNumbering& numbering) : globals(numbering.numLive()){
+	IRProgram * prog = cfg->getProc()->getProg();
+	for (Opd * global : prog->globalSyms()){
+		globals.gen(numbering.index(global));
+	}
+
+	std::vector<Opd *> uses;
+	std::vector<Opd *> defs;
+	for (BasicBlock * block : *cfg->getBlocks()){
+		BitVector gen(numbering.numLive());
+		BitVector kill(numbering.numLive());
+		QuadRange quads = block->getQuads();
+		for (auto itr = quads.rbegin(); itr != quads.rend(); ++itr){
+			DeadCodeElimination::getUseDef(*itr, uses, defs);
+			for (Opd * def : defs){
+				size_t idx = numbering.index(def);
+				if (idx >= numbering.numLive()){ continue; }
+				gen.reset(idx);
+				kill.set(idx);
+			}
+			for (Opd * use : uses){
+				size_t idx = numbering.index(use);
+				if (idx >= numbering.numLive()){ continue; }
+				gen.set(idx);
+			}
+		}
+		summaries[block] = {std::move(gen), std::move(kill)};
+	}
+}
+
+bool LivenessProblem::transfer(BasicBlock * block, 
+	const Fact& in, Fact& out){
+	const auto& summary = summaries[block];
+	Fact facts = in;
+	facts.kill(summary.second);
+	facts.gen(summary.first);
+	if (facts.sameAs(out)){
+		return false;
+	}
+	out = facts;
+	return true;
+}
+
+void DeadCodeElimination::runBlock(ControlFlowGraph * cfg, 
+	BasicBlock * block, const OpdNumbering& numbering, 
+	DeadCodeFacts facts){
+	QuadRange quads = block->getQuads();
 
-		std::set<Opd *> uses;
-		std::set<Opd *> defs;
+	auto quadItr = quads.rbegin();
+	std::vector<Quad *> deadQuads;
+	std::vector<Opd *> uses;
+	std::vector<Opd *> defs;
+	while (quadItr != quads.rend()){
+		auto quad = *quadItr;
 		getUseDef(quad, uses, defs);
+
+		bool defLive = defs.empty();
+		for (Opd * def : defs){
+			if (facts.contains(numbering.index(def))){ defLive = true; }
+		}
 		
-		if (!facts.contains(defs) && !immune(quad)){
-			deadQuads.insert(quad);
+		if (!defLive && !immune(quad)){
+			deadQuads.push_back(quad);
 		} else {
-			facts.kill(defs);
-			facts.gen(uses);
+			for (Opd * def : defs){ facts.kill(numbering.index(def)); }
+			for (Opd * use : uses){
+				size_t idx = numbering.index(use);
+				if (idx != OpdNumbering::NO_OPD){ facts.gen(idx); }
+			}
 		}
-		quadItr++;
+		++quadItr;
 	}
 
 	for (Quad * deadQuad : deadQuads){
@@ -87,39 +213,23 @@ bool DeadCodeElimination::runBlock(ControlFlowGraph * cfg, BasicBlock * block){
 			cfg->replaceWithNop(deadQuad);
 		}
 	}
-
-	DeadCodeFacts oldOut = outFacts[block];
-	if (!oldOut.sameAs(facts)){
-		outFacts[block] = facts;
-		return true;
-	}
-	return false;
 }
 
 bool DeadCodeElimination::runGraph(ControlFlowGraph * cfg){
-	bool changed = true;
-	for(BasicBlock * block : *cfg->getBlocks()){
-		DeadCodeFacts empty;
-		inFacts[block] = empty;
-		outFacts[block] = empty;
-	}
 	IRProgram * prog = cfg->getProc()->getProg();
-	std::set<Opd *> globalSyms = prog->globalSyms();
-
-	while (changed){
-		changed = false;
-		for(BasicBlock * block : *cfg->getBlocks()){
-			DeadCodeFacts in = inFacts[block];
-			for (BasicBlock * block : cfg->blockSuccessors(block)){
-				in.addFacts(outFacts[block]);
-			}
-			in.gen(globalSyms);
-			inFacts[block] = in;
-			bool blockChange = runBlock(cfg, block);
-			if (blockChange){ 
-				changed = true; 
-			}
-		}
+	OpdNumbering numbering(cfg, prog->globalSyms());
+	LivenessProblem liveness(cfg, numbering);
+	DataflowSolver<LivenessProblem> solver(cfg, liveness);
+	solver.solve();
+
+	//Only remove quads once liveness has settled; removing them
+	// during the fixpoint would trust facts that are still growing
+	for(BasicBlock * block : *cfg->getBlocks()){
+		runBlock(cfg, block, numbering, solver.inFact(block));
 	}
+
+	Procedure * proc = cfg->getProc();
+	proc->addStat("dce.blocks", solver.numBlocks());
+	proc->addStat("dce.visits", solver.numVisits());
 	return effectful;
 }
@@ -1,39 +1,82 @@
 #ifndef HOLEYC_CFG_DCE
 #define HOLEYC_CFG_DCE
 
+#include <vector>
+#include <unordered_map>
+#include "cfg.hpp"
+#include "cfg_dataflow.hpp"
+#include "bitvector.hpp"
+
 namespace holeyc{
 
+/**
+* Dense numbering of the variable operands (SymOpds and AuxOpds) that a
+* procedure's quads touch, plus the globals. Literals get no number.
+* Operands that can be live on entry to some block (globals, and any
+* operand read in a block before that block writes it) are numbered 
+* first, so block-level liveness only needs bits [0, numLive()).
+* Temporaries that never outlive their block get the higher numbers.
+**/
+class OpdNumbering{
+public:
+	static const size_t NO_OPD = static_cast<size_t>(-1);
+
+	OpdNumbering(ControlFlowGraph * cfg, const std::set<Opd *>& globals);
+	size_t index(Opd * opd) const {
+		auto found = indices.find(opd);
+		if (found == indices.end()){ return NO_OPD; }
+		return found->second;
+	}
+	Opd * opd(size_t idx) const { return opds[idx]; }
+	size_t size() const { return opds.size(); }
+	size_t numLive() const { return liveCount; }
+private:
+	void number(Opd * opd);
+
+	std::unordered_map<Opd *, size_t> indices;
+	std::vector<Opd *> opds;
+	size_t liveCount;
+};
+
 class DeadCodeFacts{
 public:
 	DeadCodeFacts(){}
-	DeadCodeFacts clone(){
-		DeadCodeFacts facts;
-		for (Opd * opd : liveOpds){ facts.liveOpds.insert(opd); }
-		return facts;
+	explicit DeadCodeFacts(size_t numOpds) : liveOpds(numOpds){}
+	void addFacts(const DeadCodeFacts& other){ 
+		liveOpds.unionWith(other.liveOpds); 
 	}
-	void addFacts(DeadCodeFacts& other){ this->gen(other.liveOpds); }
-	void gen(std::set<Opd *>& opds){
-		for(auto o : opds){ liveOpds.insert(o); }
-	}
-	void kill(std::set<Opd *>& opds){
-		for (auto o : opds){ liveOpds.erase(o); }
-	}
-	bool contains(std::set<Opd *>& opds){
-		for (auto o : opds){
-			auto itr = std::find(liveOpds.begin(), liveOpds.end(), o);
-			if (itr == liveOpds.end()){
-				return false;
-			}
-		}
-		return true;
-	}
-	bool sameAs(DeadCodeFacts& other){
-		if (!other.contains(this->liveOpds)){ return false; }
-		if (!this->contains(other.liveOpds)){ return false; }
-		return true;
+	void gen(const BitVector& opds){ liveOpds.unionWith(opds); }
+	void kill(const BitVector& opds){ liveOpds.subtract(opds); }
+	void gen(size_t opd){ liveOpds.set(opd); }
+	void kill(size_t opd){ liveOpds.reset(opd); }
+	bool contains(size_t opd) const { return liveOpds.test(opd); }
+	const BitVector& getOpds() const { return liveOpds; }
+	bool sameAs(const DeadCodeFacts& other) const {
+		return liveOpds.sameAs(other.liveOpds);
 	}
 private:
-	std::set<Opd *> liveOpds;
+	BitVector liveOpds;
+};
+
+/**
+* Backward liveness over DeadCodeFacts. Globals are treated as live
+* at the bottom of every block, since callees and the caller can read
+* them. Each block's transfer is summarized up front as the operands 
+* it reads before writing (gen) and the operands it writes (kill).
+**/
+class LivenessProblem{
+public:
+	typedef DeadCodeFacts Fact;
+	static const DataflowDirection direction = BACKWARD;
+
+	LivenessProblem(ControlFlowGraph * cfg, const OpdNumbering& numbering);
+	void initFact(BasicBlock * block, Fact& fact){ fact = globals; }
+	void meet(Fact& into, const Fact& from){ into.addFacts(from); }
+	bool transfer(BasicBlock * block, const Fact& in, Fact& out);
+private:
+	Fact globals;
+	std::unordered_map<BasicBlock *, std::pair<BitVector, BitVector>> 
+		summaries;
 };
 
 class DeadCodeElimination{
@@ -42,15 +85,16 @@ public:
 		DeadCodeElimination dce;
 		return dce.runGraph(cfg);
 	}
+	static void getUseDef(Quad * quad, 
+		std::vector<Opd *>& uses, std::vector<Opd *>& defs);
 private:
 	DeadCodeElimination() : effectful(false){}
 	bool runGraph(ControlFlowGraph * cfg);
-	bool runBlock(ControlFlowGraph * cfg, BasicBlock * block);
+	void runBlock(ControlFlowGraph * cfg, BasicBlock * block, 
+		const OpdNumbering& numbering, DeadCodeFacts facts);
 	bool immune(Quad * quad);
 
 	bool effectful;
-	std::map<BasicBlock *, DeadCodeFacts> outFacts;
-	std::map<BasicBlock *, DeadCodeFacts> inFacts;
 };
 
 }
@@ -0,0 +1,149 @@
+#include "cfg_gvn.hpp"
+#include <algorithm>
+
+using namespace holeyc;
+
+static bool commutes(BinOp op){
+	switch (op){
+	case ADD: case MULT: case OR: case AND: case EQ: case NEQ:
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool ValueNumbering::runGraph(){
+	DominatorTree * doms = cfg->getDominators();
+	struct Frame{
+		BasicBlock * block;
+		size_t nextChild;
+		std::vector<Key> pushed;
+	};
+	std::vector<Frame> walk;
+	walk.push_back({cfg->getEntryBlock(), 0, {}});
+	numberBlock(walk.back().block, walk.back().pushed);
+	while (!walk.empty()){
+		Frame& frame = walk.back();
+		const std::vector<BasicBlock *>& kids = doms->children(frame.block);
+		if (frame.nextChild < kids.size()){
+			BasicBlock * kid = kids[frame.nextChild++];
+			walk.push_back({kid, 0, {}});
+			numberBlock(kid, walk.back().pushed);
+		} else {
+			for (const Key& key : frame.pushed){
+				table.erase(key);
+			}
+			walk.pop_back();
+		}
+	}
+
+	//Phi arguments along back edges were read before their leaders
+	// were known, so give every use its final value
+	auto current = [this](Opd * opd){ return valueOf(opd); };
+	for (BasicBlock * block : *cfg->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			renameUses(quad, current);
+		}
+	}
+
+	Procedure * proc = cfg->getProc();
+	proc->addStat("gvn.eliminated", redundant);
+	proc->addStat("copyprop.eliminated", copies);
+	return redundant + copies > 0;
+}
+
+void ValueNumbering::numberBlock(BasicBlock * block, 
+	std::vector<Key>& pushed){
+	auto current = [this](Opd * opd){ return valueOf(opd); };
+	std::vector<Quad *> quads;
+	for (Quad * quad : block->getQuads()){
+		quads.push_back(quad);
+	}
+	for (Quad * quad : quads){
+		renameUses(quad, current);
+		if (auto phi = dynamic_cast<PhiQuad *>(quad)){
+			if (numberPhi(phi)){
+				drop(phi);
+				redundant++;
+			}
+			continue;
+		}
+
+		Opd * dst = nullptr;
+		Key key;
+		if (auto q = dynamic_cast<AssignQuad *>(quad)){
+			if (numberable(q->getDst()) && numberable(q->getSrc())){
+				leaders[q->getDst()] = q->getSrc();
+				drop(q);
+				copies++;
+			}
+			continue;
+		} else if (auto q = dynamic_cast<BinOpQuad *>(quad)){
+			Opd * src1 = q->getSrc1();
+			Opd * src2 = q->getSrc2();
+			if (!numberable(src1) || !numberable(src2)){ continue; }
+			if (commutes(q->getOp()) && src2 < src1){
+				std::swap(src1, src2);
+			}
+			dst = q->getDst();
+			key = Key(q->getOp(), src1, src2);
+		} else if (auto q = dynamic_cast<UnaryOpQuad *>(quad)){
+			if (!numberable(q->getSrc())){ continue; }
+			dst = q->getDst();
+			key = Key(GTE + 1 + q->getOp(), q->getSrc(), nullptr);
+		}
+		if (dst == nullptr || !dynamic_cast<SSAOpd *>(dst)){ continue; }
+
+		auto found = table.find(key);
+		if (found != table.end()){
+			leaders[dst] = found->second;
+			drop(quad);
+			redundant++;
+		} else {
+			table[key] = dst;
+			pushed.push_back(key);
+		}
+	}
+}
+
+//A phi whose arguments are all the same value (or the phi itself,
+// around a loop) is just that value
+bool ValueNumbering::numberPhi(PhiQuad * phi){
+	Opd * dst = phi->getDst();
+	Opd * same = nullptr;
+	for (size_t idx = 0; idx < phi->numArgs(); idx++){
+		Opd * arg = phi->getArg(idx);
+		if (arg == dst || arg == same){ continue; }
+		if (same != nullptr){ return false; }
+		same = arg;
+	}
+	if (same == nullptr || !numberable(same)){ return false; }
+	leaders[dst] = same;
+	return true;
+}
+
+bool ValueNumbering::numberable(Opd * opd){
+	return dynamic_cast<SSAOpd *>(opd) || dynamic_cast<LitOpd *>(opd);
+}
+
+Opd * ValueNumbering::valueOf(Opd * opd){
+	if (auto lit = dynamic_cast<LitOpd *>(opd)){
+		auto key = std::make_pair(lit->valString(), lit->getWidth());
+		auto found = lits.find(key);
+		if (found != lits.end()){ return found->second; }
+		lits[key] = lit;
+		return lit;
+	}
+	auto found = leaders.find(opd);
+	while (found != leaders.end()){
+		opd = found->second;
+		found = leaders.find(opd);
+	}
+	return opd;
+}
+
+void ValueNumbering::drop(Quad * quad){
+	if (!cfg->removeQuad(quad)){
+		cfg->replaceWithNop(quad);
+	}
+}
@@ -0,0 +1,54 @@
+#ifndef HOLEYC_CFG_GVN
+#define HOLEYC_CFG_GVN
+
+#include <map>
+#include <tuple>
+#include <unordered_map>
+#include "cfg.hpp"
+#include "cfg_loops.hpp"
+
+namespace holeyc{
+
+/**
+* Dominator-based value numbering over the SSA form (Briggs, Cooper and
+* Simpson), with copy propagation folded in. The walk follows the 
+* dominator tree with a scoped table of the operations computed so far,
+* so an operation whose operator and operand values match one that
+* dominates it is dropped and its name stands for the earlier result.
+* A copy of an SSA name or a literal is dropped the same way, as is a
+* phi whose arguments all agree.
+*
+* Only operations on SSA names and literals get numbers: globals and
+* names no definition reaches can change between two reads.
+**/
+class ValueNumbering{
+public:
+	static bool run(ControlFlowGraph * cfg){
+		ValueNumbering gvn(cfg);
+		return gvn.runGraph();
+	}
+private:
+	//Operator (unary ones offset past the binary ones) and operands
+	typedef std::tuple<int, Opd *, Opd *> Key;
+
+	ValueNumbering(ControlFlowGraph * cfgIn) : cfg(cfgIn){}
+	bool runGraph();
+	void numberBlock(BasicBlock * block, std::vector<Key>& pushed);
+	bool numberPhi(PhiQuad * phi);
+	bool numberable(Opd * opd);
+	Opd * valueOf(Opd * opd);
+	void drop(Quad * quad);
+
+	ControlFlowGraph * cfg;
+	//The earlier name (or literal) each dropped name stands for
+	std::unordered_map<Opd *, Opd *> leaders;
+	//One literal object per value, so equal literals compare equal
+	std::map<std::pair<std::string, OpdWidth>, Opd *> lits;
+	std::map<Key, Opd *> table;
+	size_t redundant = 0;
+	size_t copies = 0;
+};
+
+}
+
+#endif
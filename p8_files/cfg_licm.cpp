@@ -0,0 +1,248 @@
+#include "cfg_licm.hpp"
+#include "cfg_dce.hpp"
+#include <algorithm>
+
+using namespace holeyc;
+
+bool LoopInvariantMotion::runGraph(){
+	Procedure * proc = cfg->getProc();
+	globals = proc->getProg()->globalSyms();
+	for (BasicBlock * block : *cfg->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			std::vector<Opd *> uses;
+			std::vector<Opd *> defs;
+			DeadCodeElimination::getUseDef(quad, uses, defs);
+			for (Opd * opd : defs){
+				if (auto version = dynamic_cast<SSAOpd *>(opd)){
+					maxVersion = std::max(maxVersion, version->getVersion());
+				}
+			}
+		}
+	}
+
+	//Adding a preheader changes the edges, which rebuilds the loops,
+	// so start over after each one. A header that is split off is a
+	// new block, and the next round finds its preheader
+	size_t preheaders = 0;
+	std::set<BasicBlock *> tried;
+	bool changed = true;
+	while (changed){
+		changed = false;
+		for (Loop * loop : cfg->getLoops()->getLoops()){
+			if (!tried.insert(loop->getHeader()).second){ continue; }
+			if (preheaderOf(loop) != nullptr){ continue; }
+			if (addPreheader(loop)){
+				preheaders++;
+				changed = true;
+				break;
+			}
+		}
+	}
+
+	//Inner loops come after the loops around them
+	size_t hoisted = 0;
+	const std::vector<Loop *>& loops = cfg->getLoops()->getLoops();
+	for (auto itr = loops.rbegin(); itr != loops.rend(); ++itr){
+		BasicBlock * preheader = preheaderOf(*itr);
+		if (preheader != nullptr){
+			hoisted += hoist(*itr, preheader);
+		}
+	}
+
+	proc->addStat("licm.preheaders", preheaders);
+	proc->addStat("licm.hoisted", hoisted);
+	return hoisted > 0;
+}
+
+//The only block outside the loop that enters it, if it goes nowhere
+// else and the header is not reached through a call's return
+BasicBlock * LoopInvariantMotion::preheaderOf(Loop * loop){
+	CFGEdge * entry = nullptr;
+	for (CFGEdge * in : loop->getHeader()->getInEdges()){
+		if (loop->contains(in->src)){ continue; }
+		if (entry != nullptr){ return nullptr; }
+		entry = in;
+	}
+	if (entry == nullptr || entry->type == LINK){ return nullptr; }
+	BasicBlock * pred = entry->src;
+	if (pred->getOutEdges().size() != 1){ return nullptr; }
+	Quad * term = pred->getTerminator();
+	if (dynamic_cast<JmpIfQuad *>(term) || dynamic_cast<JmpCmpQuad *>(term)){
+		return nullptr;
+	}
+	return pred;
+}
+
+//A new block takes over the header's labels, so every jump from 
+// outside now lands on it, and the rest of the header is split off 
+// behind it with a fresh label for the back edges. When several blocks
+// enter the loop, the header's phis are split in two: the new block 
+// joins the values coming from outside, and the header joins that with
+// the values from the back edges
+bool LoopInvariantMotion::addPreheader(Loop * loop){
+	BasicBlock * header = loop->getHeader();
+	std::unordered_set<BasicBlock *> latches;
+	size_t entries = 0;
+	for (CFGEdge * in : header->getInEdges()){
+		if (in->type == LINK){ return false; }
+		if (loop->contains(in->src)){
+			if (in->type != JUMP){ return false; }
+			latches.insert(in->src);
+		} else {
+			entries++;
+		}
+	}
+	if (entries == 0){ return false; }
+
+	std::vector<Quad *> front;
+	std::vector<PhiQuad *> phis;
+	for (Quad * quad : header->getQuads()){
+		auto phi = dynamic_cast<PhiQuad *>(quad);
+		if (phi == nullptr){ break; }
+		phis.push_back(phi);
+		Opd * base = phi->getDst();
+		if (auto version = dynamic_cast<SSAOpd *>(base)){
+			base = version->getBase();
+		}
+		auto outer = new PhiQuad(new SSAOpd(base, ++maxVersion));
+		for (size_t idx = 0; idx < phi->numArgs(); ){
+			if (latches.count(phi->getPred(idx)) > 0){
+				idx++;
+				continue;
+			}
+			outer->addArg(phi->getPred(idx), phi->getArg(idx));
+			phi->removeArg(idx);
+		}
+		front.push_back(outer);
+	}
+	front.push_back(new NopQuad());
+
+	Quad * leader = header->getLeader();
+	std::list<Label *> labels = leader->getLabels();
+	leader->clearLabels();
+	for (Quad * quad : front){
+		cfg->insertQuadBefore(leader, quad);
+	}
+	for (Label * label : labels){
+		front[0]->addLabel(label);
+	}
+	BasicBlock * body = cfg->splitBlock(leader);
+	Label * label = cfg->getProc()->makeLabel();
+	leader->addLabel(label);
+
+	//The split moved the header's out edges (and a loop of the header
+	// to itself) onto the body, so phis naming the header as their 
+	// predecessor now mean the body
+	auto moved = [&](BasicBlock * pred){
+		return pred == header ? body : pred;
+	};
+	for (CFGEdge * out : body->getOutEdges()){
+		for (Quad * quad : out->tgt->getQuads()){
+			auto phi = dynamic_cast<PhiQuad *>(quad);
+			if (phi == nullptr){ break; }
+			for (size_t idx = 0; idx < phi->numArgs(); idx++){
+				phi->setPred(idx, moved(phi->getPred(idx)));
+			}
+		}
+	}
+	for (size_t idx = 0; idx < phis.size(); idx++){
+		for (size_t arg = 0; arg < phis[idx]->numArgs(); arg++){
+			phis[idx]->setPred(arg, moved(phis[idx]->getPred(arg)));
+		}
+		auto outer = static_cast<PhiQuad *>(front[idx]);
+		phis[idx]->addArg(header, outer->getDst());
+	}
+
+	std::vector<CFGEdge *> backEdges;
+	for (CFGEdge * in : header->getInEdges()){
+		if (latches.count(in->src) > 0 || in->src == body){
+			backEdges.push_back(in);
+		}
+	}
+	for (CFGEdge * back : backEdges){
+		BasicBlock * latch = back->src;
+		Quad * jmp = latch->getTerminator();
+		if (auto gotoQuad = dynamic_cast<JmpQuad *>(jmp)){
+			gotoQuad->setTarget(label);
+		} else if (auto ifzQuad = dynamic_cast<JmpIfQuad *>(jmp)){
+			ifzQuad->setTarget(label);
+		} else if (auto cmpQuad = dynamic_cast<JmpCmpQuad *>(jmp)){
+			cmpQuad->setTarget(label);
+		}
+		cfg->removeEdge(back);
+		cfg->addEdge(latch, body, JUMP);
+	}
+	return true;
+}
+
+//Blocks come in reverse postorder, so whatever a quad reads from the
+// loop was defined (and, if invariant, hoisted) ahead of it
+size_t LoopInvariantMotion::hoist(Loop * loop, BasicBlock * preheader){
+	loopDefs.clear();
+	loopCalls = false;
+	for (BasicBlock * block : loop->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			std::vector<Opd *> uses;
+			std::vector<Opd *> defs;
+			DeadCodeElimination::getUseDef(quad, uses, defs);
+			loopDefs.insert(defs.begin(), defs.end());
+			if (dynamic_cast<CallQuad *>(quad)){ loopCalls = true; }
+		}
+	}
+
+	size_t hoisted = 0;
+	for (BasicBlock * block : loop->getBlocks()){
+		std::vector<Quad *> quads;
+		for (Quad * quad : block->getQuads()){
+			quads.push_back(quad);
+		}
+		for (Quad * quad : quads){
+			if (!hoistable(quad)){ continue; }
+			if (!cfg->removeQuad(quad)){
+				cfg->replaceWithNop(quad);
+			}
+			quad->clearLabels();
+			Quad * end = preheader->getTerminator();
+			if (dynamic_cast<JmpQuad *>(end)){
+				cfg->insertQuadBefore(end, quad);
+			} else {
+				cfg->insertQuadAfter(end, quad);
+			}
+			hoisted++;
+		}
+	}
+	return hoisted;
+}
+
+bool LoopInvariantMotion::hoistable(Quad * quad){
+	Opd * dst = nullptr;
+	if (auto binOp = dynamic_cast<BinOpQuad *>(quad)){
+		if (binOp->getOp() == DIV){
+			Opd * divisor = binOp->getSrc2();
+			if (!dynamic_cast<LitOpd *>(divisor)){ return false; }
+			std::string val = divisor->valString();
+			if (val == "0" || val == "-1"){ return false; }
+		}
+		dst = binOp->getDst();
+	} else if (auto unOp = dynamic_cast<UnaryOpQuad *>(quad)){
+		dst = unOp->getDst();
+	} else if (auto assign = dynamic_cast<AssignQuad *>(quad)){
+		dst = assign->getDst();
+	}
+	if (dst == nullptr || !dynamic_cast<SSAOpd *>(dst)){ return false; }
+
+	std::vector<Opd *> uses;
+	std::vector<Opd *> defs;
+	DeadCodeElimination::getUseDef(quad, uses, defs);
+	for (Opd * use : uses){
+		if (!invariant(use)){ return false; }
+	}
+	loopDefs.erase(dst);
+	return true;
+}
+
+bool LoopInvariantMotion::invariant(Opd * opd){
+	if (dynamic_cast<LitOpd *>(opd)){ return true; }
+	if (loopDefs.count(opd) > 0){ return false; }
+	return !loopCalls || globals.count(opd) == 0;
+}
@@ -0,0 +1,58 @@
+#ifndef HOLEYC_CFG_LICM
+#define HOLEYC_CFG_LICM
+
+#include <set>
+#include <unordered_set>
+#include "cfg.hpp"
+#include "cfg_loops.hpp"
+
+namespace holeyc{
+
+/**
+* Loop-invariant code motion over the SSA form. Every natural loop gets
+* a preheader: the one block outside the loop that leads into the 
+* header and nowhere else. Where there is none, a new block is split 
+* off in front of the header to take every edge from outside, and the
+* back edges are moved to jump past it. Loops are then handled innermost first, so code hoisted out of an
+* inner loop can go on out of the loops around it.
+*
+* An operation or copy into an SSA name moves to the preheader when
+* each operand is a literal or something the loop never writes. A 
+* global is only invariant in a loop with no calls in it. Each SSA name
+* has one definition, which dominates every use, so moving it up to a 
+* block that dominates the whole loop keeps that true; the moved quads
+* cannot fault, so running them when the loop might not have is fine.
+* Division is only moved when its divisor is a literal other than 0 or
+* -1. Calls, intrinsic I/O and writes to anything other than SSA names
+* stay where they are.
+*
+* A header that a back edge falls into, or that is the return point of
+* a call, gets no preheader.
+**/
+class LoopInvariantMotion{
+public:
+	static bool run(ControlFlowGraph * cfg){
+		LoopInvariantMotion licm(cfg);
+		return licm.runGraph();
+	}
+private:
+	LoopInvariantMotion(ControlFlowGraph * cfgIn) : cfg(cfgIn){}
+	bool runGraph();
+	BasicBlock * preheaderOf(Loop * loop);
+	bool addPreheader(Loop * loop);
+	size_t hoist(Loop * loop, BasicBlock * preheader);
+	bool hoistable(Quad * quad);
+	bool invariant(Opd * opd);
+
+	ControlFlowGraph * cfg;
+	std::set<Opd *> globals;
+	//What the loop being handled writes, and whether it calls anything
+	std::unordered_set<Opd *> loopDefs;
+	bool loopCalls = false;
+	//New phis get versions past every one in use
+	size_t maxVersion = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,231 @@
+#include "cfg_loops.hpp"
+#include <algorithm>
+
+using namespace holeyc;
+
+const size_t DominatorTree::NO_IDOM;
+
+DominatorTree::DominatorTree(ControlFlowGraph * cfg){
+	rpo = cfg->reversePostorder(false);
+	size_t numBlocks = rpo.size();
+	for (size_t idx = 0; idx < numBlocks; idx++){
+		indices[rpo[idx]] = idx;
+	}
+
+	//The entry is its own idom while iterating, which stops the
+	// intersect walks at the root. Everything else starts undefined
+	idoms.assign(numBlocks, NO_IDOM);
+	idoms[0] = 0;
+	bool changed = true;
+	while (changed){
+		changed = false;
+		for (size_t idx = 1; idx < numBlocks; idx++){
+			size_t newIdom = NO_IDOM;
+			for (BasicBlock * pred : rpo[idx]->predecessors()){
+				if (!reachable(pred)){ continue; }
+				size_t predIdx = index(pred);
+				if (idoms[predIdx] == NO_IDOM){ continue; }
+				if (newIdom == NO_IDOM){
+					newIdom = predIdx;
+				} else {
+					newIdom = intersect(predIdx, newIdom);
+				}
+			}
+			if (idoms[idx] != newIdom){
+				idoms[idx] = newIdom;
+				changed = true;
+			}
+		}
+	}
+
+	kids.resize(numBlocks);
+	for (size_t idx = 1; idx < numBlocks; idx++){
+		kids[idoms[idx]].push_back(rpo[idx]);
+	}
+	numberTree();
+	computeFrontiers();
+}
+
+//Walk both fingers up the tree to their nearest common ancestor. A
+// dominator always precedes the blocks it dominates in reverse
+// postorder, so the finger with the larger position is the one to move
+size_t DominatorTree::intersect(size_t finger1, size_t finger2) const {
+	while (finger1 != finger2){
+		while (finger1 > finger2){ finger1 = idoms[finger1]; }
+		while (finger2 > finger1){ finger2 = idoms[finger2]; }
+	}
+	return finger1;
+}
+
+void DominatorTree::numberTree(){
+	size_t numBlocks = rpo.size();
+	treeIn.assign(numBlocks, 0);
+	treeOut.assign(numBlocks, 0);
+	if (numBlocks == 0){ return; }
+
+	size_t clock = 0;
+	std::vector<std::pair<size_t, size_t>> stack;
+	stack.push_back({0, 0});
+	treeIn[0] = clock++;
+	while (!stack.empty()){
+		size_t idx = stack.back().first;
+		size_t next = stack.back().second;
+		if (next < kids[idx].size()){
+			stack.back().second++;
+			size_t kid = index(kids[idx][next]);
+			treeIn[kid] = clock++;
+			stack.push_back({kid, 0});
+		} else {
+			treeOut[idx] = clock - 1;
+			stack.pop_back();
+		}
+	}
+}
+
+//Each join point is in the frontier of every block on the tree paths
+// from its predecessors up to (but not including) its idom. Blocks are
+// handled in reverse postorder, so every frontier comes out in that
+// order and a repeat can only be the most recently added block
+void DominatorTree::computeFrontiers(){
+	frontiers.resize(rpo.size());
+	for (size_t idx = 0; idx < rpo.size(); idx++){
+		BasicBlock * join = rpo[idx];
+		if (join->getInEdges().size() < 2){ continue; }
+		for (BasicBlock * pred : join->predecessors()){
+			if (!reachable(pred)){ continue; }
+			size_t runner = index(pred);
+			while (runner != idoms[idx]){
+				std::vector<BasicBlock *>& df = frontiers[runner];
+				if (df.empty() || df.back() != join){
+					df.push_back(join);
+				}
+				if (runner == 0){ break; }
+				runner = idoms[runner];
+			}
+		}
+	}
+}
+
+BasicBlock * DominatorTree::idom(BasicBlock * block) const {
+	if (!reachable(block)){ return nullptr; }
+	size_t idx = index(block);
+	if (idx == 0){ return nullptr; }
+	return rpo[idoms[idx]];
+}
+
+bool DominatorTree::dominates(BasicBlock * dom, BasicBlock * block) const {
+	if (!reachable(dom) || !reachable(block)){ return false; }
+	size_t domIdx = index(dom);
+	size_t blockIdx = index(block);
+	return treeIn[domIdx] <= treeIn[blockIdx]
+		&& treeIn[blockIdx] <= treeOut[domIdx];
+}
+
+const std::vector<BasicBlock *>& DominatorTree::children(
+	BasicBlock * block) const {
+	static const std::vector<BasicBlock *> none;
+	if (!reachable(block)){ return none; }
+	return kids[index(block)];
+}
+
+const std::vector<BasicBlock *>& DominatorTree::frontier(
+	BasicBlock * block) const {
+	static const std::vector<BasicBlock *> none;
+	if (!reachable(block)){ return none; }
+	return frontiers[index(block)];
+}
+
+LoopForest::LoopForest(ControlFlowGraph * cfg, const DominatorTree& doms){
+	//An edge is a back edge when its target dominates its source.
+	// Visiting sources in reverse postorder creates the loops in
+	// header order, since a header precedes its whole body
+	std::unordered_map<BasicBlock *, Loop *> byHeader;
+	for (BasicBlock * block : doms.order()){
+		for (CFGEdge * edge : block->getOutEdges()){
+			if (!doms.dominates(edge->tgt, block)){ continue; }
+			backEdges.insert(edge);
+			backEdgeList.push_back(edge);
+			Loop *& loop = byHeader[edge->tgt];
+			if (loop == nullptr){
+				loop = new Loop(edge->tgt);
+				loops.push_back(loop);
+			}
+			loop->backEdges.push_back(edge);
+			collectBody(loop, edge, doms);
+		}
+	}
+
+	for (Loop * loop : loops){
+		for (BasicBlock * block : doms.order()){
+			if (loop->contains(block)){ loop->blocks.push_back(block); }
+		}
+	}
+
+	//Two natural loops with different headers are either disjoint or
+	// nested, and the outer one is strictly bigger. Going from big to
+	// small, the innermost loop seen so far that holds a header is
+	// that loop's parent
+	std::stable_sort(loops.begin(), loops.end(),
+		[](Loop * a, Loop * b){
+			return a->blocks.size() > b->blocks.size();
+		}
+	);
+	for (Loop * loop : loops){
+		auto outer = innermost.find(loop->header);
+		if (outer == innermost.end()){
+			topLevel.push_back(loop);
+		} else {
+			loop->parent = outer->second;
+			loop->depth = outer->second->depth + 1;
+			outer->second->children.push_back(loop);
+		}
+		for (BasicBlock * block : loop->blocks){
+			innermost[block] = loop;
+		}
+	}
+}
+
+LoopForest::~LoopForest(){
+	for (Loop * loop : loops){
+		delete loop;
+	}
+}
+
+//Everything that reaches the back edge's source without going through
+// the header. Only reachable blocks count; an unreachable block may
+// jump into the loop, but it is not dominated by the header
+void LoopForest::collectBody(Loop * loop, CFGEdge * backEdge,
+	const DominatorTree& doms){
+	loop->members.insert(loop->header);
+	std::vector<BasicBlock *> worklist;
+	if (loop->members.insert(backEdge->src).second){
+		worklist.push_back(backEdge->src);
+	}
+	while (!worklist.empty()){
+		BasicBlock * block = worklist.back();
+		worklist.pop_back();
+		for (BasicBlock * pred : block->predecessors()){
+			if (!doms.reachable(pred)){ continue; }
+			if (loop->members.insert(pred).second){
+				worklist.push_back(pred);
+			}
+		}
+	}
+}
+
+Loop * LoopForest::loopFor(BasicBlock * block){
+	auto found = innermost.find(block);
+	if (found == innermost.end()){ return nullptr; }
+	return found->second;
+}
+
+size_t LoopForest::depth(BasicBlock * block){
+	Loop * loop = loopFor(block);
+	if (loop == nullptr){ return 0; }
+	return loop->depth;
+}
+
+bool LoopForest::isHeader(BasicBlock * block){
+	Loop * loop = loopFor(block);
+	return loop != nullptr && loop->header == block;
+}
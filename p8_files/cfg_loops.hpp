@@ -0,0 +1,118 @@
+#ifndef HOLEYC_CFG_LOOPS
+#define HOLEYC_CFG_LOOPS
+
+#include <unordered_set>
+#include <vector>
+#include <unordered_map>
+#include "cfg.hpp"
+
+namespace holeyc{
+
+/**
+* Dominator tree of a ControlFlowGraph, computed with the iterative
+* algorithm of Cooper, Harvey and Kennedy ("A Simple, Fast Dominance
+* Algorithm"): immediate dominators are refined in reverse postorder
+* by intersecting the dominator-tree paths of each block's processed
+* predecessors until nothing changes. Blocks unreachable from the entry
+* have no dominator and dominate nothing.
+**/
+class DominatorTree{
+public:
+	DominatorTree(ControlFlowGraph * cfg);
+
+	//Immediate dominator, or nullptr for the entry and unreachable blocks
+	BasicBlock * idom(BasicBlock * block) const;
+	//Reflexive: every reachable block dominates itself
+	bool dominates(BasicBlock * dom, BasicBlock * block) const;
+	bool reachable(BasicBlock * block) const {
+		return indices.count(block) > 0;
+	}
+	const std::vector<BasicBlock *>& children(BasicBlock * block) const;
+	//Dominance frontier, in reverse postorder
+	const std::vector<BasicBlock *>& frontier(BasicBlock * block) const;
+	//Reachable blocks in reverse postorder
+	const std::vector<BasicBlock *>& order() const { return rpo; }
+private:
+	size_t index(BasicBlock * block) const { return indices.at(block); }
+	size_t intersect(size_t finger1, size_t finger2) const;
+	void computeFrontiers();
+	void numberTree();
+
+	static const size_t NO_IDOM = static_cast<size_t>(-1);
+
+	//Everything below is indexed by reverse postorder position
+	std::vector<BasicBlock *> rpo;
+	std::unordered_map<BasicBlock *, size_t> indices;
+	std::vector<size_t> idoms;
+	std::vector<std::vector<BasicBlock *>> kids;
+	std::vector<std::vector<BasicBlock *>> frontiers;
+
+	//Preorder entry/exit times of a walk over the dominator tree,
+	// so that dominance is an interval check
+	std::vector<size_t> treeIn;
+	std::vector<size_t> treeOut;
+};
+
+/**
+* A natural loop: the header plus every block that can reach one of
+* the loop's back edges without passing through the header. Back edges
+* sharing a header are merged into a single loop.
+**/
+class Loop{
+public:
+	Loop(BasicBlock * headerIn) : header(headerIn), parent(nullptr),
+	  depth(1){ }
+	BasicBlock * getHeader(){ return header; }
+	//Includes the header and the blocks of nested loops, in reverse
+	// postorder (so the header comes first)
+	const std::vector<BasicBlock *>& getBlocks(){ return blocks; }
+	bool contains(BasicBlock * block){ return members.count(block) > 0; }
+	const std::vector<CFGEdge *>& getBackEdges(){ return backEdges; }
+	Loop * getParent(){ return parent; }
+	const std::vector<Loop *>& getChildren(){ return children; }
+	//Outermost loops have depth 1
+	size_t getDepth(){ return depth; }
+private:
+	BasicBlock * header;
+	std::vector<BasicBlock *> blocks;
+	std::unordered_set<BasicBlock *> members;
+	std::vector<CFGEdge *> backEdges;
+	Loop * parent;
+	std::vector<Loop *> children;
+	size_t depth;
+friend class LoopForest;
+};
+
+/**
+* Loop-nesting forest of a ControlFlowGraph. Only natural loops are
+* found; a cycle entered at more than one block (irreducible flow) has
+* no back edge under this definition and is not reported as a loop.
+**/
+class LoopForest{
+public:
+	LoopForest(ControlFlowGraph * cfg, const DominatorTree& doms);
+	~LoopForest();
+	//Every loop, outer loops before the loops nested in them
+	const std::vector<Loop *>& getLoops(){ return loops; }
+	const std::vector<Loop *>& getTopLevel(){ return topLevel; }
+	//Innermost loop holding the block, or nullptr
+	Loop * loopFor(BasicBlock * block);
+	//Number of loops holding the block, 0 outside any loop
+	size_t depth(BasicBlock * block);
+	bool isBackEdge(CFGEdge * edge){ return backEdges.count(edge) > 0; }
+	const std::vector<CFGEdge *>& getBackEdges(){ return backEdgeList; }
+	bool isHeader(BasicBlock * block);
+private:
+	void collectBody(Loop * loop, CFGEdge * backEdge,
+		const DominatorTree& doms);
+
+	std::vector<Loop *> loops;
+	std::vector<Loop *> topLevel;
+	std::unordered_map<BasicBlock *, Loop *> innermost;
+	std::unordered_set<CFGEdge *> backEdges;
+	std::vector<CFGEdge *> backEdgeList;
+};
+
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include "cfg_regalloc.hpp"
+#include <algorithm>
+
+using namespace holeyc;
+
+const std::vector<std::string>& LinearScan::callerSaved(){
+	static const std::vector<std::string> regs = {"%r10", "%r11"};
+	return regs;
+}
+
+const std::vector<std::string>& LinearScan::calleeSaved(){
+	static const std::vector<std::string> regs = {
+		"%rbx", "%r12", "%r13", "%r14", "%r15"
+	};
+	return regs;
+}
+
+std::vector<std::string> LinearScan::runGraph(){
+	globals = cfg->getProc()->getProg()->globalSyms();
+	regs = callerSaved();
+	regs.insert(regs.end(), calleeSaved().begin(), calleeSaved().end());
+
+	buildIntervals();
+	allocate();
+
+	std::vector<std::string> used;
+	for (const std::string& reg : calleeSaved()){
+		for (LiveInterval * interval : intervals){
+			if (interval->reg == reg){
+				used.push_back(reg);
+				break;
+			}
+		}
+	}
+	Procedure * proc = cfg->getProc();
+	proc->addStat("regalloc.registers", intervals.size() - numSpilled);
+	proc->addStat("regalloc.spilled", numSpilled);
+
+	for (LiveInterval * interval : intervals){
+		interval->opd->setRegister(interval->reg);
+		delete interval;
+	}
+	return used;
+}
+
+//Temps, locals and formals. Globals have to be in memory whenever
+// another procedure may look at them, and strings are addresses
+bool LinearScan::candidate(Opd * opd){
+	if (globals.count(opd) > 0){ return false; }
+	if (auto aux = dynamic_cast<AuxOpd *>(opd)){
+		return !aux->isStringLit();
+	}
+	return dynamic_cast<SymOpd *>(opd) != nullptr;
+}
+
+void LinearScan::buildIntervals(){
+	OpdNumbering numbering(cfg, globals);
+	LivenessProblem liveness(cfg, numbering);
+	DataflowSolver<LivenessProblem> solver(cfg, liveness);
+	solver.solve();
+
+	std::vector<LiveInterval *> byOpd(numbering.size(), nullptr);
+	size_t pos = 0;
+	auto extend = [this, &numbering, &byOpd, &pos](size_t idx){
+		LiveInterval *& interval = byOpd[idx];
+		if (interval != nullptr){
+			interval->start = std::min(interval->start, pos);
+			interval->end = std::max(interval->end, pos);
+		} else if (candidate(numbering.opd(idx))){
+			interval = new LiveInterval(numbering.opd(idx), pos);
+		}
+	};
+
+	std::vector<Opd *> uses;
+	std::vector<Opd *> defs;
+	for (Quad * quad : *cfg->getProc()->getQuads()){
+		BasicBlock * block = cfg->getBlock(quad);
+		if (block != nullptr && quad == block->getLeader()){
+			solver.outFact(block).getOpds().forEach(extend);
+		}
+		DeadCodeElimination::getUseDef(quad, uses, defs);
+		for (Opd * opd : uses){
+			size_t idx = numbering.index(opd);
+			if (idx != OpdNumbering::NO_OPD){ extend(idx); }
+		}
+		for (Opd * opd : defs){
+			size_t idx = numbering.index(opd);
+			if (idx != OpdNumbering::NO_OPD){ extend(idx); }
+		}
+		if (dynamic_cast<CallQuad *>(quad)
+		    || dynamic_cast<IntrinsicOutputQuad *>(quad)
+		    || dynamic_cast<IntrinsicInputQuad *>(quad)){
+			calls.push_back(pos);
+		}
+		if (block != nullptr && quad == block->getTerminator()){
+			solver.inFact(block).getOpds().forEach(extend);
+		}
+		pos++;
+	}
+
+	for (LiveInterval * interval : byOpd){
+		if (interval == nullptr){ continue; }
+		auto call = std::upper_bound(calls.begin(), calls.end(),
+			interval->start);
+		interval->crossesCall = call != calls.end()
+			&& *call < interval->end;
+		intervals.push_back(interval);
+	}
+	std::stable_sort(intervals.begin(), intervals.end(),
+		[](LiveInterval * a, LiveInterval * b){
+			return a->start < b->start;
+		}
+	);
+}
+
+//Caller-saved registers come first in regs, and do not survive a call
+bool LinearScan::usable(const LiveInterval * interval, size_t reg){
+	return !interval->crossesCall || reg >= callerSaved().size();
+}
+
+void LinearScan::allocate(){
+	std::vector<bool> taken(regs.size(), false);
+	//Active intervals, each with the index of its register
+	std::vector<std::pair<LiveInterval *, size_t>> active;
+
+	for (LiveInterval * current : intervals){
+		//An interval that ends where this one starts is only read by
+		// the quad that writes this one, which loads before it stores
+		size_t kept = 0;
+		for (size_t idx = 0; idx < active.size(); idx++){
+			if (active[idx].first->end <= current->start){
+				taken[active[idx].second] = false;
+			} else {
+				active[kept++] = active[idx];
+			}
+		}
+		active.resize(kept);
+
+		size_t chosen = regs.size();
+		for (size_t reg = 0; reg < regs.size(); reg++){
+			if (!taken[reg] && usable(current, reg)){
+				chosen = reg;
+				break;
+			}
+		}
+		if (chosen != regs.size()){
+			taken[chosen] = true;
+			current->reg = regs[chosen];
+			active.push_back({current, chosen});
+			continue;
+		}
+
+		//Out of registers: give up on whichever interval ends last
+		size_t victim = active.size();
+		for (size_t idx = 0; idx < active.size(); idx++){
+			if (!usable(current, active[idx].second)){ continue; }
+			if (victim == active.size()
+			    || active[idx].first->end > active[victim].first->end){
+				victim = idx;
+			}
+		}
+		numSpilled++;
+		if (victim == active.size()
+		    || active[victim].first->end <= current->end){
+			continue;
+		}
+		current->reg = active[victim].first->reg;
+		active[victim].first->reg = "";
+		active[victim].first = current;
+	}
+}
@@ -0,0 +1,70 @@
+#ifndef HOLEYC_CFG_REGALLOC
+#define HOLEYC_CFG_REGALLOC
+
+#include <string>
+#include <vector>
+#include "cfg.hpp"
+#include "cfg_dce.hpp"
+
+namespace holeyc{
+
+/**
+* The stretch of a procedure's quads, by position in program order,
+* over which an operand may be live: from its first definition (or
+* the top of the first block it is live into) to its last use (or the
+* bottom of the last block it is live out of). Holes are not tracked.
+**/
+class LiveInterval{
+public:
+	LiveInterval(Opd * opdIn, size_t at)
+	: opd(opdIn), start(at), end(at), crossesCall(false){ }
+	Opd * opd;
+	size_t start;
+	size_t end;
+	//A call (or an intrinsic, which calls into the runtime) falls
+	// strictly inside the interval
+	bool crossesCall;
+	std::string reg;
+};
+
+/**
+* Linear-scan register allocation over live intervals. The temps,
+* locals and formals of a procedure compete for the allocatable
+* registers; an interval that spans a call may only take a callee-saved
+* one. When no register is free, whichever of the active intervals and
+* the new one ends last is spilled, and stays in its stack slot for the
+* whole procedure.
+*
+* Registers are recorded on the operands (see Opd::setRegister). run
+* returns the callee-saved registers that were handed out, which the
+* procedure must preserve for its caller.
+**/
+class LinearScan{
+public:
+	static std::vector<std::string> run(ControlFlowGraph * cfg){
+		LinearScan scan(cfg);
+		return scan.runGraph();
+	}
+	//Registers the scan may hand out. The code generator keeps %rax,
+	// %rcx and %rdx as scratch, and the rest carry arguments
+	static const std::vector<std::string>& callerSaved();
+	static const std::vector<std::string>& calleeSaved();
+private:
+	LinearScan(ControlFlowGraph * cfgIn) : cfg(cfgIn){}
+	std::vector<std::string> runGraph();
+	void buildIntervals();
+	void allocate();
+	bool candidate(Opd * opd);
+	bool usable(const LiveInterval * interval, size_t reg);
+
+	ControlFlowGraph * cfg;
+	std::set<Opd *> globals;
+	std::vector<LiveInterval *> intervals;
+	std::vector<size_t> calls;
+	std::vector<std::string> regs;
+	size_t numSpilled = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,91 @@
+#include "cfg_slots.hpp"
+
+using namespace holeyc;
+
+std::map<Opd *, size_t> SlotColoring::runGraph(){
+	globals = cfg->getProc()->getProg()->globalSyms();
+	OpdNumbering numbering(cfg, globals);
+	for (size_t idx = 0; idx < numbering.size(); idx++){
+		if (candidate(numbering.opd(idx))){
+			candidates.set(idx);
+		} else {
+			others.set(idx);
+		}
+	}
+
+	LivenessProblem liveness(cfg, numbering);
+	DataflowSolver<LivenessProblem> solver(cfg, liveness);
+	solver.solve();
+	interference.resize(numbering.size());
+	for (BasicBlock * block : *cfg->getBlocks()){
+		runBlock(block, numbering, solver.inFact(block));
+	}
+
+	std::map<Opd *, size_t> slots;
+	std::vector<size_t> slotOf(numbering.size(), 0);
+	candidates.forEach([&](size_t idx){
+		Opd * opd = numbering.opd(idx);
+		bool bytes = opd->getWidth() == BYTE;
+		std::vector<bool> taken;
+		interference[idx].forEach([&](size_t other){
+			if (other >= idx){ return; }
+			if ((numbering.opd(other)->getWidth() == BYTE) != bytes){
+				return;
+			}
+			if (taken.size() <= slotOf[other]){
+				taken.resize(slotOf[other] + 1, false);
+			}
+			taken[slotOf[other]] = true;
+		});
+		size_t slot = 0;
+		while (slot < taken.size() && taken[slot]){ slot++; }
+		slotOf[idx] = slot;
+		slots[opd] = slot;
+	});
+	return slots;
+}
+
+//Globals have a home in the data section, strings are addresses, and
+// an operand in a register needs no slot at all
+bool SlotColoring::candidate(Opd * opd){
+	if (globals.count(opd) > 0 || opd->inRegister()){ return false; }
+	if (auto aux = dynamic_cast<AuxOpd *>(opd)){
+		return !aux->isStringLit();
+	}
+	return dynamic_cast<SymOpd *>(opd) != nullptr;
+}
+
+void SlotColoring::runBlock(BasicBlock * block,
+	const OpdNumbering& numbering, DeadCodeFacts live){
+	std::vector<Opd *> uses;
+	std::vector<Opd *> defs;
+	QuadRange quads = block->getQuads();
+	for (auto quadItr = quads.rbegin(); quadItr != quads.rend(); ++quadItr){
+		Quad * quad = *quadItr;
+		DeadCodeElimination::getUseDef(quad, uses, defs);
+
+		//What is live right after the quad, less the copy's source
+		BitVector after = live.getOpds();
+		after.subtract(others);
+		if (auto copy = dynamic_cast<AssignQuad *>(quad)){
+			size_t src = numbering.index(copy->getSrc());
+			if (src != OpdNumbering::NO_OPD){ after.reset(src); }
+		}
+		for (Opd * def : defs){
+			size_t idx = numbering.index(def);
+			if (idx == OpdNumbering::NO_OPD || !candidates.test(idx)){
+				continue;
+			}
+			interference[idx].unionWith(after);
+			after.forEach([this, idx](size_t other){
+				interference[other].set(idx);
+			});
+		}
+
+		for (Opd * def : defs){ live.kill(numbering.index(def)); }
+		for (Opd * use : uses){
+			size_t idx = numbering.index(use);
+			if (idx != OpdNumbering::NO_OPD){ live.gen(idx); }
+		}
+	}
+}
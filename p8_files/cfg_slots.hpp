@@ -0,0 +1,49 @@
+#ifndef HOLEYC_CFG_SLOTS
+#define HOLEYC_CFG_SLOTS
+
+#include <map>
+#include <set>
+#include <vector>
+#include "bitvector.hpp"
+#include "cfg.hpp"
+#include "cfg_dce.hpp"
+
+namespace holeyc{
+
+/**
+* Stack slot assignment for the operands that register allocation
+* left in memory. Two of them interfere when one is written while the
+* other is live, except that a copy's destination does not interfere
+* with its source, since both then hold the same value. Operands of
+* the same width that do not interfere may share a slot.
+*
+* Slots are handed out greedily, the lowest free one first, in operand
+* numbering order. run maps each operand the procedure refers to to
+* its slot index among the operands of its width (bytes or quadwords);
+* globals, strings and operands in registers are left out.
+**/
+class SlotColoring{
+public:
+	static std::map<Opd *, size_t> run(ControlFlowGraph * cfg){
+		SlotColoring coloring(cfg);
+		return coloring.runGraph();
+	}
+private:
+	SlotColoring(ControlFlowGraph * cfgIn) : cfg(cfgIn){}
+	std::map<Opd *, size_t> runGraph();
+	void runBlock(BasicBlock * block, const OpdNumbering& numbering,
+		DeadCodeFacts live);
+	bool candidate(Opd * opd);
+
+	ControlFlowGraph * cfg;
+	std::set<Opd *> globals;
+	//Numbering indices of the operands that need a slot
+	BitVector candidates;
+	//Numbering indices of everything else
+	BitVector others;
+	std::vector<BitVector> interference;
+};
+
+}
+
+#endif
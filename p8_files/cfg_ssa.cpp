@@ -0,0 +1,398 @@
+#include "cfg_ssa.hpp"
+#include <algorithm>
+
+using namespace holeyc;
+
+const size_t SSAConstruction::NO_VAR;
+
+bool SSAConstruction::runGraph(){
+	doms = cfg->getDominators();
+	findVars();
+	placePhis();
+	rename();
+	cfg->getProc()->addStat("ssa.phis", numPhis);
+	return true;
+}
+
+size_t SSAConstruction::varIndex(Opd * opd){
+	auto found = varIndices.find(opd);
+	if (found == varIndices.end()){ return NO_VAR; }
+	return found->second;
+}
+
+void SSAConstruction::findVars(){
+	std::set<Opd *> globals = cfg->getProc()->getProg()->globalSyms();
+	std::vector<Opd *> uses;
+	std::vector<Opd *> defs;
+
+	//Every written non-global becomes a variable
+	for (BasicBlock * block : doms->order()){
+		for (Quad * quad : block->getQuads()){
+			DeadCodeElimination::getUseDef(quad, uses, defs);
+			for (Opd * def : defs){
+				if (globals.count(def) > 0){ continue; }
+				if (varIndices.count(def) > 0){ continue; }
+				varIndices[def] = vars.size();
+				vars.push_back(def);
+			}
+		}
+	}
+
+	//Record the blocks writing each variable, and which variables
+	// are read in a block before that block writes them. The stamp
+	// is the last block that wrote each variable
+	defBlocks.resize(vars.size());
+	crossing.assign(vars.size(), false);
+	std::vector<BasicBlock *> stamp(vars.size(), nullptr);
+	for (BasicBlock * block : doms->order()){
+		for (Quad * quad : block->getQuads()){
+			DeadCodeElimination::getUseDef(quad, uses, defs);
+			for (Opd * use : uses){
+				size_t var = varIndex(use);
+				if (var != NO_VAR && stamp[var] != block){
+					crossing[var] = true;
+				}
+			}
+			for (Opd * def : defs){
+				size_t var = varIndex(def);
+				if (var == NO_VAR || stamp[var] == block){ continue; }
+				stamp[var] = block;
+				defBlocks[var].push_back(block);
+			}
+		}
+	}
+}
+
+void SSAConstruction::placePhis(){
+	//hasPhi and queued hold the last variable that put a phi in (or
+	// queued) each block, so they never need clearing between variables
+	std::unordered_map<BasicBlock *, size_t> hasPhi;
+	std::unordered_map<BasicBlock *, size_t> queued;
+	for (size_t var = 0; var < vars.size(); var++){
+		if (!crossing[var]){ continue; }
+		std::vector<BasicBlock *> worklist = defBlocks[var];
+		for (BasicBlock * block : worklist){ queued[block] = var; }
+		while (!worklist.empty()){
+			BasicBlock * block = worklist.back();
+			worklist.pop_back();
+			for (BasicBlock * join : doms->frontier(block)){
+				auto placed = hasPhi.find(join);
+				if (placed != hasPhi.end() && placed->second == var){
+					continue;
+				}
+				hasPhi[join] = var;
+				PhiQuad * phi = new PhiQuad(vars[var]);
+				cfg->insertQuadBefore(join->getLeader(), phi);
+				phiVars[phi] = var;
+				numPhis++;
+
+				auto seen = queued.find(join);
+				if (seen == queued.end() || seen->second != var){
+					queued[join] = var;
+					worklist.push_back(join);
+				}
+			}
+		}
+	}
+}
+
+Opd * SSAConstruction::newVersion(size_t var){
+	Opd * version = new SSAOpd(vars[var], ++nextVersion[var]);
+	stacks[var].push_back(version);
+	return version;
+}
+
+//Walk the dominator tree, so that the top of each variable's stack
+// is always the definition that reaches the current block
+void SSAConstruction::rename(){
+	nextVersion.assign(vars.size(), 0);
+	stacks.resize(vars.size());
+	for (size_t var = 0; var < vars.size(); var++){
+		stacks[var].push_back(vars[var]);
+	}
+
+	struct Frame{
+		BasicBlock * block;
+		size_t nextChild;
+		std::vector<size_t> pushed;
+	};
+	std::vector<Frame> walk;
+	walk.push_back({cfg->getEntryBlock(), 0, {}});
+	renameBlock(walk.back().block, walk.back().pushed);
+	while (!walk.empty()){
+		Frame& frame = walk.back();
+		const std::vector<BasicBlock *>& kids = doms->children(frame.block);
+		if (frame.nextChild < kids.size()){
+			BasicBlock * kid = kids[frame.nextChild++];
+			walk.push_back({kid, 0, {}});
+			renameBlock(kid, walk.back().pushed);
+		} else {
+			for (size_t var : frame.pushed){
+				stacks[var].pop_back();
+			}
+			walk.pop_back();
+		}
+	}
+}
+
+void SSAConstruction::renameBlock(BasicBlock * block,
+	std::vector<size_t>& pushed){
+	auto current = [this](Opd * opd){
+		size_t var = varIndex(opd);
+		if (var == NO_VAR){ return opd; }
+		return stacks[var].back();
+	};
+	auto fresh = [this, &pushed](Opd * opd){
+		size_t var = varIndex(opd);
+		if (var == NO_VAR){ return opd; }
+		pushed.push_back(var);
+		return newVersion(var);
+	};
+
+	for (Quad * quad : block->getQuads()){
+		if (auto phi = dynamic_cast<PhiQuad *>(quad)){
+			size_t var = phiVars[phi];
+			pushed.push_back(var);
+			phi->setDst(newVersion(var));
+		} else {
+			renameUses(quad, current);
+			renameDef(quad, fresh);
+		}
+	}
+
+	//One phi argument per edge, so a block reached by both edges of
+	// a conditional jump passes the same value twice
+	for (CFGEdge * edge : block->getOutEdges()){
+		for (Quad * quad : edge->tgt->getQuads()){
+			auto phi = dynamic_cast<PhiQuad *>(quad);
+			if (phi == nullptr){ break; }
+			phi->addArg(block, stacks[phiVars[phi]].back());
+		}
+	}
+}
+
+bool SSADestruction::runGraph(){
+	globals = cfg->getProc()->getProg()->globalSyms();
+	isolatePhis();
+
+	OpdNumbering numbering(cfg, globals);
+	parents.resize(numbering.size());
+	for (size_t idx = 0; idx < parents.size(); idx++){
+		parents[idx] = idx;
+	}
+	interference.resize(numbering.size());
+	names.assign(numbering.size(), nullptr);
+
+	buildInterference(numbering);
+	coalesce(numbering);
+	assignNames(numbering);
+	size_t removed = rewrite(numbering);
+
+	Procedure * proc = cfg->getProc();
+	proc->addStat("ssa.coalesced", removed);
+	return true;
+}
+
+void SSADestruction::isolatePhis(){
+	//New names continue past the highest version in use
+	auto note = [this](Opd * opd){
+		if (auto version = dynamic_cast<SSAOpd *>(opd)){
+			maxVersion = std::max(maxVersion, version->getVersion());
+		}
+		return opd;
+	};
+	std::vector<PhiQuad *> phis;
+	for (BasicBlock * block : *cfg->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			if (auto phi = dynamic_cast<PhiQuad *>(quad)){
+				phis.push_back(phi);
+			}
+			renameUses(quad, note);
+			renameDef(quad, note);
+		}
+	}
+
+	//Every argument is copied into one fresh name at the end of its
+	// predecessor, and the phi becomes a copy out of that name
+	for (PhiQuad * phi : phis){
+		Opd * dst = phi->getDst();
+		Opd * base = dst;
+		if (auto version = dynamic_cast<SSAOpd *>(dst)){
+			base = version->getBase();
+		}
+		Opd * joined = new SSAOpd(base, ++maxVersion);
+
+		//The same predecessor can appear twice (both edges of a
+		// conditional jump), always with the same argument
+		std::unordered_set<BasicBlock *> done;
+		for (size_t idx = 0; idx < phi->numArgs(); idx++){
+			BasicBlock * pred = phi->getPred(idx);
+			if (!done.insert(pred).second){ continue; }
+			appendToPred(pred, new AssignQuad(joined, phi->getArg(idx)));
+		}
+		cfg->replaceQuad(phi, new AssignQuad(dst, joined));
+	}
+}
+
+//Copies for a phi go at the very end of the predecessor, but ahead
+// of a jump or call that ends it
+void SSADestruction::appendToPred(BasicBlock * pred, Quad * copy){
+	Quad * term = pred->getTerminator();
+	if (dynamic_cast<JmpQuad *>(term) || dynamic_cast<JmpIfQuad *>(term)
+	    || dynamic_cast<JmpCmpQuad *>(term)
+	    || dynamic_cast<CallQuad *>(term)){
+		cfg->insertQuadBefore(term, copy);
+	} else {
+		cfg->insertQuadAfter(term, copy);
+	}
+}
+
+bool SSADestruction::candidate(const OpdNumbering& numbering, Opd * opd){
+	return numbering.index(opd) != OpdNumbering::NO_OPD
+		&& globals.count(opd) == 0;
+}
+
+//Names interfere when one is written while the other is live. The
+// source of a copy does not interfere with its destination because of
+// that copy, since both hold the same value afterwards
+void SSADestruction::buildInterference(const OpdNumbering& numbering){
+	IRProgram * prog = cfg->getProc()->getProg();
+	LivenessProblem liveness(cfg, numbering);
+	DataflowSolver<LivenessProblem> solver(cfg, liveness);
+	solver.solve();
+
+	std::vector<Opd *> uses;
+	std::vector<Opd *> defs;
+	for (BasicBlock * block : *cfg->getBlocks()){
+		DeadCodeFacts live = solver.inFact(block);
+		QuadRange quads = block->getQuads();
+		for (auto itr = quads.rbegin(); itr != quads.rend(); ++itr){
+			Quad * quad = *itr;
+			DeadCodeElimination::getUseDef(quad, uses, defs);
+			size_t copySrc = OpdNumbering::NO_OPD;
+			if (auto copy = dynamic_cast<AssignQuad *>(quad)){
+				copySrc = numbering.index(copy->getSrc());
+			}
+			for (Opd * def : defs){
+				if (!candidate(numbering, def)){ continue; }
+				size_t defIdx = numbering.index(def);
+				live.getOpds().forEach([&](size_t liveIdx){
+					if (liveIdx == defIdx || liveIdx == copySrc){ return; }
+					if (!candidate(numbering, numbering.opd(liveIdx))){
+						return;
+					}
+					interference[defIdx].insert(liveIdx);
+					interference[liveIdx].insert(defIdx);
+				});
+			}
+			for (Opd * def : defs){
+				size_t idx = numbering.index(def);
+				if (idx != OpdNumbering::NO_OPD){ live.kill(idx); }
+			}
+			for (Opd * use : uses){
+				size_t idx = numbering.index(use);
+				if (idx != OpdNumbering::NO_OPD){ live.gen(idx); }
+			}
+		}
+	}
+}
+
+size_t SSADestruction::find(size_t idx){
+	while (parents[idx] != idx){
+		parents[idx] = parents[parents[idx]];
+		idx = parents[idx];
+	}
+	return idx;
+}
+
+//Merge b's class into a's, moving b's interference edges over
+void SSADestruction::unite(size_t a, size_t b){
+	a = find(a);
+	b = find(b);
+	if (a == b){ return; }
+	parents[b] = a;
+	std::unordered_set<size_t> moved;
+	moved.swap(interference[b]);
+	for (size_t other : moved){
+		interference[other].erase(b);
+		if (other == a){ continue; }
+		interference[other].insert(a);
+		interference[a].insert(other);
+	}
+}
+
+void SSADestruction::coalesce(const OpdNumbering& numbering){
+	for (BasicBlock * block : *cfg->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			auto copy = dynamic_cast<AssignQuad *>(quad);
+			if (copy == nullptr){ continue; }
+			Opd * dst = copy->getDst();
+			Opd * src = copy->getSrc();
+			if (!candidate(numbering, dst) || !candidate(numbering, src)){
+				continue;
+			}
+			if (dst->getWidth() != src->getWidth()){ continue; }
+			size_t dstRoot = find(numbering.index(dst));
+			size_t srcRoot = find(numbering.index(src));
+			if (dstRoot == srcRoot){ continue; }
+			if (interference[dstRoot].count(srcRoot) > 0){ continue; }
+			unite(dstRoot, srcRoot);
+		}
+	}
+}
+
+//A class holding one of the original operands takes the first such
+// operand. Classes made only of versions take their variable if no
+// other class did, and a new temporary otherwise
+void SSADestruction::assignNames(const OpdNumbering& numbering){
+	std::unordered_set<Opd *> claimed;
+	for (size_t idx = 0; idx < numbering.size(); idx++){
+		Opd * opd = numbering.opd(idx);
+		if (!candidate(numbering, opd)){ continue; }
+		if (dynamic_cast<SSAOpd *>(opd)){ continue; }
+		size_t root = find(idx);
+		if (names[root] == nullptr){
+			names[root] = opd;
+			claimed.insert(opd);
+		}
+	}
+
+	Procedure * proc = cfg->getProc();
+	for (size_t idx = 0; idx < numbering.size(); idx++){
+		auto version = dynamic_cast<SSAOpd *>(numbering.opd(idx));
+		if (version == nullptr){ continue; }
+		size_t root = find(idx);
+		if (names[root] != nullptr){ continue; }
+		Opd * base = version->getBase();
+		if (claimed.insert(base).second){
+			names[root] = base;
+		} else {
+			names[root] = proc->makeTmp(version->getWidth());
+		}
+	}
+}
+
+size_t SSADestruction::rewrite(const OpdNumbering& numbering){
+	auto plain = [this, &numbering](Opd * opd){
+		if (!candidate(numbering, opd)){ return opd; }
+		return names[find(numbering.index(opd))];
+	};
+
+	std::vector<AssignQuad *> selfCopies;
+	for (BasicBlock * block : *cfg->getBlocks()){
+		for (Quad * quad : block->getQuads()){
+			renameUses(quad, plain);
+			renameDef(quad, plain);
+			auto copy = dynamic_cast<AssignQuad *>(quad);
+			if (copy != nullptr && copy->getDst() == copy->getSrc()){
+				selfCopies.push_back(copy);
+			}
+		}
+	}
+	for (AssignQuad * copy : selfCopies){
+		if (!cfg->removeQuad(copy)){
+			cfg->replaceWithNop(copy);
+		}
+	}
+	return selfCopies.size();
+}
@@ -0,0 +1,95 @@
+#ifndef HOLEYC_CFG_SSA
+#define HOLEYC_CFG_SSA
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "cfg.hpp"
+#include "cfg_loops.hpp"
+#include "cfg_dce.hpp"
+
+namespace holeyc{
+
+/**
+* Rewrites a procedure into SSA form. Every SymOpd and AuxOpd that the
+* procedure writes, other than the globals, gets a fresh SSAOpd for
+* each definition. Phis are placed on the iterated dominance frontier
+* of each variable's definitions, but only for variables that are read
+* in some block before that block writes them (semi-pruned SSA), and
+* names are assigned in one walk over the dominator tree.
+*
+* Reads that no definition reaches keep the original operand, which
+* acts as version 0. Blocks unreachable from the entry are left alone.
+**/
+class SSAConstruction{
+public:
+	static bool run(ControlFlowGraph * cfg){
+		SSAConstruction ssa(cfg);
+		return ssa.runGraph();
+	}
+private:
+	SSAConstruction(ControlFlowGraph * cfgIn) : cfg(cfgIn), numPhis(0){}
+	bool runGraph();
+	void findVars();
+	void placePhis();
+	void rename();
+	void renameBlock(BasicBlock * block, std::vector<size_t>& pushed);
+	Opd * newVersion(size_t var);
+	size_t varIndex(Opd * opd);
+
+	static const size_t NO_VAR = static_cast<size_t>(-1);
+
+	ControlFlowGraph * cfg;
+	DominatorTree * doms;
+	std::unordered_map<Opd *, size_t> varIndices;
+	std::vector<Opd *> vars;
+	std::vector<std::vector<BasicBlock *>> defBlocks;
+	std::vector<bool> crossing;
+	std::vector<size_t> nextVersion;
+	std::vector<std::vector<Opd *>> stacks;
+	std::unordered_map<PhiQuad *, size_t> phiVars;
+	size_t numPhis;
+};
+
+/**
+* Translates a procedure out of SSA form. Each phi is first isolated
+* through one fresh name: every argument is copied into it at the end
+* of its predecessor and the phi's result is copied out of it in place
+* of the phi. Copies are then coalesced greedily on an interference
+* graph built from liveness, and every class of coalesced names is 
+* given a plain operand: the original variable where possible, a new
+* temporary otherwise. Copies whose ends share an operand vanish.
+**/
+class SSADestruction{
+public:
+	static bool run(ControlFlowGraph * cfg){
+		SSADestruction ssa(cfg);
+		return ssa.runGraph();
+	}
+private:
+	SSADestruction(ControlFlowGraph * cfgIn) : cfg(cfgIn), maxVersion(0){}
+	bool runGraph();
+	void isolatePhis();
+	void appendToPred(BasicBlock * pred, Quad * copy);
+	void buildInterference(const OpdNumbering& numbering);
+	void coalesce(const OpdNumbering& numbering);
+	void assignNames(const OpdNumbering& numbering);
+	size_t rewrite(const OpdNumbering& numbering);
+
+	size_t find(size_t idx);
+	void unite(size_t a, size_t b);
+	bool candidate(const OpdNumbering& numbering, Opd * opd);
+
+	ControlFlowGraph * cfg;
+	std::set<Opd *> globals;
+	size_t maxVersion;
+
+	//Union-find over operand numbers; adjacency is kept per root
+	std::vector<size_t> parents;
+	std::vector<std::unordered_set<size_t>> interference;
+	std::vector<Opd *> names;
+};
+
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include "cfg_strength.hpp"
+
+using namespace holeyc;
+
+static bool isLit(Opd * opd, const char * val){
+	auto lit = dynamic_cast<LitOpd *>(opd);
+	return lit != nullptr && lit->valString() == val;
+}
+
+bool StrengthReduction::runGraph(){
+	size_t reduced = 0;
+	for (BasicBlock * block : *cfg->getBlocks()){
+		Quad * quad = block->getLeader();
+		while (true){
+			bool last = quad == block->getTerminator();
+			if (auto binOp = dynamic_cast<BinOpQuad *>(quad)){
+				if (Quad * cheaper = reduce(binOp)){
+					cfg->replaceQuad(binOp, cheaper);
+					quad = cheaper;
+					reduced++;
+				}
+			}
+			if (last){ break; }
+			quad = quad->getNext();
+		}
+	}
+	cfg->getProc()->addStat("strength.reduced", reduced);
+	return reduced > 0;
+}
+
+Quad * StrengthReduction::reduce(BinOpQuad * quad){
+	Opd * dst = quad->getDst();
+	Opd * src1 = quad->getSrc1();
+	Opd * src2 = quad->getSrc2();
+	if (quad->getOp() == DIV){
+		if (isLit(src2, "1")){ return new AssignQuad(dst, src1); }
+		return nullptr;
+	}
+	if (quad->getOp() != MULT){ return nullptr; }
+
+	//Put the literal factor, if any, on the right
+	if (dynamic_cast<LitOpd *>(src1) != nullptr){
+		std::swap(src1, src2);
+	}
+	if (isLit(src2, "0")){
+		return new AssignQuad(dst, new LitOpd("0", dst->getWidth()));
+	}
+	if (isLit(src2, "1")){ return new AssignQuad(dst, src1); }
+	if (isLit(src2, "-1")){ return new UnaryOpQuad(dst, NEG, src1); }
+	if (isLit(src2, "2")){ return new BinOpQuad(dst, ADD, src1, src1); }
+	return nullptr;
+}
@@ -0,0 +1,35 @@
+#ifndef HOLEYC_CFG_STRENGTH
+#define HOLEYC_CFG_STRENGTH
+
+#include "cfg.hpp"
+
+namespace holeyc{
+
+/**
+* Rewrites multiplications and divisions by a literal into cheaper
+* quads where the quads can say so: a product with 0 becomes 0, with 1
+* a copy, with -1 a negation and with 2 an addition of the other 
+* operand to itself, and a quotient by 1 becomes a copy. Division by
+* -1 is kept, since it faults on the most negative dividend.
+*
+* Other constant factors and divisors are left to instruction 
+* selection, which can use shifts, leaq and multiply-high sequences
+* that have no quad of their own.
+**/
+class StrengthReduction{
+public:
+	static bool run(ControlFlowGraph * cfg){
+		StrengthReduction reduction(cfg);
+		return reduction.runGraph();
+	}
+private:
+	StrengthReduction(ControlFlowGraph * cfgIn) : cfg(cfgIn){}
+	bool runGraph();
+	Quad * reduce(BinOpQuad * quad);
+
+	ControlFlowGraph * cfg;
+};
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+#include "cfg_tail.hpp"
+#include <algorithm>
+#include <set>
+
+using namespace holeyc;
+
+//Arguments past the sixth are passed in the caller's frame
+static const size_t numArgRegs = 6;
+
+bool TailCalls::runGraph(){
+	size_t numFormals = proc->getFormals().size();
+	std::vector<CallQuad *> recursive;
+	size_t jumps = 0;
+	for (BasicBlock * block : *cfg->getBlocks()){
+		auto call = dynamic_cast<CallQuad *>(block->getTerminator());
+		if (call == nullptr || !inTailPosition(call)){ continue; }
+		std::vector<SetArgQuad *> args = argsOf(call);
+		if (call->getCallee()->getName() == proc->getName()){
+			if (args.size() == numFormals){ recursive.push_back(call); }
+			continue;
+		}
+		if (args.empty() || args.back()->getIndex() <= numArgRegs){
+			call->setTailOf(proc);
+			jumps++;
+		}
+	}
+
+	if (!recursive.empty()){
+		//Split before rewriting, since the entry block may hold a call
+		BasicBlock * body = bodyBlock();
+		for (CallQuad * call : recursive){
+			eliminateRecursion(call, body);
+		}
+		//Whatever used to pick up the results of those calls
+		cfg->removeUnreachableBlocks();
+	}
+	proc->addStat("tailcalls.recursive", recursive.size());
+	proc->addStat("tailcalls.jumps", jumps);
+	return jumps > 0 || !recursive.empty();
+}
+
+//Past the call, only the result may be handled before the leave: the
+// getret, copies of it into temps and a setret of the last copy, with
+// jumps or fallthroughs in between. A void call must reach the leave
+// with nothing at all
+bool TailCalls::inTailPosition(CallQuad * call){
+	BasicBlock * block = cfg->getBlock(call);
+	BasicBlock * next = nullptr;
+	for (CFGEdge * out : block->getOutEdges()){
+		if (out->type == LINK){ next = out->tgt; }
+	}
+	Opd * result = nullptr;
+	std::set<BasicBlock *> seen;
+	while (next != nullptr){
+		if (!seen.insert(next).second){ return false; }
+		for (Quad * quad : next->getQuads()){
+			if (dynamic_cast<LeaveQuad *>(quad)){ return true; }
+			if (auto getRet = dynamic_cast<GetRetQuad *>(quad)){
+				if (result != nullptr){ return false; }
+				result = getRet->getDst();
+			} else if (auto assign = dynamic_cast<AssignQuad *>(quad)){
+				if (result == nullptr || assign->getSrc() != result){
+					return false;
+				}
+				if (!dynamic_cast<AuxOpd *>(assign->getDst())){
+					return false;
+				}
+				result = assign->getDst();
+			} else if (auto setRet = dynamic_cast<SetRetQuad *>(quad)){
+				if (result == nullptr || setRet->getSrc() != result){
+					return false;
+				}
+			} else if (!dynamic_cast<JmpQuad *>(quad)
+			    && !dynamic_cast<NopQuad *>(quad)){
+				return false;
+			}
+		}
+		if (next->getOutEdges().size() != 1){ return false; }
+		next = next->getOutEdges().front()->tgt;
+	}
+	return false;
+}
+
+//The setargs right before the call, in index order
+std::vector<SetArgQuad *> TailCalls::argsOf(CallQuad * call){
+	std::vector<SetArgQuad *> args;
+	BasicBlock * block = cfg->getBlock(call);
+	Quad * quad = call;
+	while (quad != block->getLeader()){
+		auto arg = dynamic_cast<SetArgQuad *>(quad->getPrev());
+		if (arg == nullptr){ break; }
+		args.push_back(arg);
+		quad = arg;
+	}
+	std::reverse(args.begin(), args.end());
+	return args;
+}
+
+//The first quad past the getargs, made the labeled leader of a block
+BasicBlock * TailCalls::bodyBlock(){
+	Quad * first = cfg->getEntryBlock()->getLeader()->getNext();
+	while (dynamic_cast<GetArgQuad *>(first)){
+		first = first->getNext();
+	}
+	BasicBlock * body = cfg->splitBlock(first);
+	if (first->getLabel() == nullptr){
+		first->addLabel(proc->makeLabel());
+	}
+	return body;
+}
+
+void TailCalls::eliminateRecursion(CallQuad * call, BasicBlock * body){
+	BasicBlock * block = cfg->getBlock(call);
+	std::vector<SetArgQuad *> args = argsOf(call);
+	std::list<SymOpd *> formalList = proc->getFormals();
+	std::vector<SymOpd *> formals(formalList.begin(), formalList.end());
+	std::vector<Opd *> srcs;
+	for (SetArgQuad * arg : args){
+		srcs.push_back(arg->getSrc());
+	}
+
+	//The formals are written in order, so an argument that reads a 
+	// formal some earlier copy overwrites is saved in a temp first
+	for (size_t later = 0; later < srcs.size(); later++){
+		for (size_t idx = 0; idx < later; idx++){
+			if (srcs[later] != formals[idx] || srcs[idx] == formals[idx]){
+				continue;
+			}
+			AuxOpd * tmp = proc->makeTmp(srcs[later]->getWidth());
+			cfg->insertQuadBefore(args.front(), 
+				new AssignQuad(tmp, srcs[later]));
+			srcs[later] = tmp;
+			break;
+		}
+	}
+	for (size_t idx = 0; idx < args.size(); idx++){
+		if (srcs[idx] == formals[idx]){
+			cfg->removeQuad(args[idx]);
+		} else {
+			cfg->replaceQuad(args[idx], 
+				new AssignQuad(formals[idx], srcs[idx]));
+		}
+	}
+
+	cfg->replaceQuad(call, new JmpQuad(body->getLeader()->getLabel()));
+	for (CFGEdge * out : block->getOutEdges()){
+		if (out->type == LINK){
+			cfg->removeEdge(out);
+			break;
+		}
+	}
+	cfg->addEdge(block, body, JUMP);
+}
@@ -0,0 +1,40 @@
+#ifndef HOLEYC_CFG_TAIL
+#define HOLEYC_CFG_TAIL
+
+#include "cfg.hpp"
+
+namespace holeyc{
+
+/**
+* Finds calls in tail position: calls whose result, if any, is only 
+* picked up, copied between temps and handed back by setret on the
+* way to the leave. 
+*
+* A call of the procedure itself becomes copies of the arguments into
+* the formals and a jump back to the quad after the getargs, which
+* turns the recursion into a loop. Any other tail call whose arguments
+* all go in registers is marked as one, so code generation can tear
+* the frame down and jump to the callee instead of calling it.
+**/
+class TailCalls{
+public:
+	static bool run(ControlFlowGraph * cfg){
+		TailCalls tails(cfg);
+		return tails.runGraph();
+	}
+private:
+	TailCalls(ControlFlowGraph * cfgIn) 
+	: cfg(cfgIn), proc(cfgIn->getProc()){}
+	bool runGraph();
+	bool inTailPosition(CallQuad * call);
+	std::vector<SetArgQuad *> argsOf(CallQuad * call);
+	BasicBlock * bodyBlock();
+	void eliminateRecursion(CallQuad * call, BasicBlock * body);
+
+	ControlFlowGraph * cfg;
+	Procedure * proc;
+};
+
+}
+
+#endif
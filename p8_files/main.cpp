@@ -1,5 +1,8 @@
 #include <fstream>
 #include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
 
 #include "errors.hpp"
 #include "scanner.hpp"
@@ -7,7 +10,9 @@
 #include "name_analysis.hpp"
 #include "type_analysis.hpp"
 #include "3ac.hpp"
+#include "3ac_inline.hpp"
 #include "cfg.hpp"
+#include "thread_pool.hpp"
 
 using namespace std;
 using namespace holeyc;
@@ -23,6 +28,10 @@ static void usageAndDie(){
 	<< " [-o <ASMFile>]"
 	<< " [-z]"
 	<< " [-d <CFGDir>]"
+	<< " [-s <statsFile>]"
+	<< " [-j <jobs>]"
+	<< " [-fcompact-temps]"
+	<< " [-finline-limit=<n>]"
 	<< "\n"
 	;
 	std::cout << std::flush;
@@ -135,21 +144,72 @@ static void write3AC(holeyc::IRProgram * prog, const char * outPath){
 	}
 }
 
-static list<ControlFlowGraph *> * getCFGs(IRProgram * prog){
-	std::list<ControlFlowGraph *> * cfgs;
-	cfgs = new std::list<ControlFlowGraph *>();
-	for (auto proc : *prog->getProcs()){
-		ControlFlowGraph * cfg = CFGFactory::buildCFG(proc);
-		cfgs->push_back(cfg);
+static void writeX64(holeyc::IRProgram * prog, const char * outPath){
+	if (strcmp(outPath, "--") == 0){
+		prog->toX64(std::cout);
+	} else {
+		std::ofstream outStream(outPath);
+		if (!outStream.good()){
+			std::string msg = "Bad output file ";
+			msg += outPath;
+			throw new holeyc::InternalError(msg.c_str());
+		}
+		prog->toX64(outStream);
+		outStream.close();
+	}
+}
+
+static void writeStats(holeyc::IRProgram * prog, const char * outPath){
+	std::string stats = prog->statsString();
+	if (strcmp(outPath, "--") == 0){
+		std::cout << stats << std::flush;
+	} else {
+		std::ofstream outStream(outPath);
+		outStream << stats;
+		outStream.close();
+	}
+}
+
+//Build (and optionally optimize) the graph of every procedure. With
+// more than one job the procedures are spread over a thread pool; 
+// each graph lands in its procedure's slot, so the result is in 
+// program order either way. Inlining looks at the whole program, so
+// it runs first, on its own
+static list<ControlFlowGraph *> * getCFGs(IRProgram * prog, 
+	bool optimize, size_t jobs, size_t inlineLimit){
+	if (optimize){ Inliner::run(prog, inlineLimit); }
+	std::vector<Procedure *> procs(prog->getProcs()->begin(), 
+		prog->getProcs()->end());
+	std::vector<ControlFlowGraph *> built(procs.size(), nullptr);
+	auto buildOne = [&procs, &built, optimize](size_t idx){
+		ControlFlowGraph * cfg = CFGFactory::buildCFG(procs[idx]);
+		if (optimize){ cfg->optimize(); }
+		built[idx] = cfg;
+	};
+
+	if (jobs <= 1 || procs.size() <= 1){
+		for (size_t idx = 0; idx < procs.size(); idx++){
+			buildOne(idx);
+		}
+	} else {
+		ThreadPool pool(std::min(jobs, procs.size()));
+		for (size_t idx = 0; idx < procs.size(); idx++){
+			pool.submit([&buildOne, idx](){ buildOne(idx); });
+		}
+		pool.wait();
 	}
+
+	std::list<ControlFlowGraph *> * cfgs;
+	cfgs = new std::list<ControlFlowGraph *>(built.begin(), built.end());
 	return cfgs;
 }
 
-static IRProgram * do3AC(const char * inputPath){
+static IRProgram * do3AC(const char * inputPath, bool compactTemps){
 	holeyc::TypeAnalysis * typeAnalysis = doTypeAnalysis(inputPath);
 	if (typeAnalysis == nullptr){ return nullptr; }
 	
-	IRProgram * prog = typeAnalysis->ast->to3AC(typeAnalysis);
+	IRProgram * prog = typeAnalysis->ast->to3AC(typeAnalysis, 
+		compactTemps);
 	return prog;
 }
 
@@ -186,6 +246,14 @@ int main(int argc, char * argv[]){
 					   // X64 representation
 	bool doOptimize = false;           // 
 	const char * cfgDir = NULL;        // 
+	const char * statsFile = NULL;     // Output file for
+					   // optimization counters
+	size_t jobs = 1;                   // Procedures to build and
+					   // optimize at once
+	bool compactTemps = false;         // Reuse dead temps when
+					   // lowering to 3AC
+	size_t inlineLimit = Inliner::DEFAULT_LIMIT; // Largest net
+					   // growth an inlined call may cost
 	
 	bool useful = false; // Check whether the command is 
                          // a no-op
@@ -229,6 +297,26 @@ int main(int argc, char * argv[]){
 				if (i >= argc){ usageAndDie(); }
 				else { cfgDir = argv[i]; }
 				useful = true;
+			} else if (argv[i][1] == 's'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				else { statsFile = argv[i]; }
+			} else if (argv[i][1] == 'j'){
+				i++;
+				if (i >= argc){ usageAndDie(); }
+				char * end = nullptr;
+				long count = strtol(argv[i], &end, 10);
+				if (*end != '\0' || count < 1){ usageAndDie(); }
+				jobs = static_cast<size_t>(count);
+			} else if (strcmp(argv[i], "-fcompact-temps") == 0){
+				compactTemps = true;
+			} else if (strncmp(argv[i], "-finline-limit=", 15) == 0){
+				char * end = nullptr;
+				long limit = strtol(argv[i] + 15, &end, 10);
+				if (end == argv[i] + 15 || *end != '\0' || limit < 0){
+					usageAndDie();
+				}
+				inlineLimit = static_cast<size_t>(limit);
 			} else {
 				std::cerr << "Unknown option"
 				  << " " << argv[i] << "\n";
@@ -274,43 +362,31 @@ int main(int argc, char * argv[]){
 		}
 
 		if (threeACFile != NULL){
-			auto prog = do3AC(input);
+			auto prog = do3AC(input, compactTemps);
 			if (prog == nullptr){ return 1; }
 			if (doOptimize){
-				auto cfgs = getCFGs(prog);
-				for(auto cfg : *cfgs){
-					cfg->optimize();
-				}
+				getCFGs(prog, true, jobs, inlineLimit);
 			}
 			write3AC(prog, threeACFile);
+			if (statsFile != NULL){ writeStats(prog, statsFile); }
 		}
 
 		if (asmFile != NULL){
-			auto prog = do3AC(input);
+			auto prog = do3AC(input, compactTemps);
 			if (prog == nullptr){ return 1; }
 			if (doOptimize){
-				auto cfgs = getCFGs(prog);
-				for(auto cfg : *cfgs){
-					cfg->optimize();
-				}
+				getCFGs(prog, true, jobs, inlineLimit);
 			}
-			std::cerr << "This option is not available for this project";
-			std::cerr << " however, you may import your solution from";
-			std::cerr << " the previous project to ensure your optimized";
-			std::cerr << " code works." << std::endl;
-			return 1;
+			writeX64(prog, asmFile);
+			if (statsFile != NULL){ writeStats(prog, statsFile); }
 		}
 
 		if (cfgDir != NULL){
-			IRProgram * prog = do3AC(input);
+			IRProgram * prog = do3AC(input, compactTemps);
 			if (prog == nullptr){ return 1; }
-			auto cfgs = getCFGs(prog);
-			if (doOptimize){
-				for(auto cfg : *cfgs){
-					cfg->optimize();
-				}
-			}
+			auto cfgs = getCFGs(prog, doOptimize, jobs, inlineLimit);
 			writeCFGs(cfgs, cfgDir);
+			if (statsFile != NULL){ writeStats(prog, statsFile); }
 		}
 	} catch (holeyc::ToDoError * e){
 		std::cerr << "ToDoError: " << e->msg() << "\n";
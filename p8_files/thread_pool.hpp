@@ -0,0 +1,131 @@
+#ifndef HOLEYC_THREAD_POOL
+#define HOLEYC_THREAD_POOL
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace holeyc{
+
+/**
+* A fixed set of worker threads with one task deque each. Submitted
+* tasks are dealt round-robin onto the deques; a worker runs tasks off
+* the back of its own deque and, once that is empty, steals from the
+* front of the others, so a few long tasks do not leave threads idle.
+* The first exception a task throws is handed back from wait().
+**/
+class ThreadPool{
+public:
+	explicit ThreadPool(size_t numWorkers)
+	: pending(0), queued(0), nextQueue(0), stopping(false){
+		for (size_t idx = 0; idx < numWorkers; idx++){
+			queues.emplace_back(new TaskQueue());
+		}
+		for (size_t idx = 0; idx < numWorkers; idx++){
+			workers.emplace_back(&ThreadPool::work, this, idx);
+		}
+	}
+
+	~ThreadPool(){
+		{
+			std::lock_guard<std::mutex> guard(stateLock);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers){
+			worker.join();
+		}
+	}
+
+	void submit(std::function<void()> task){
+		{
+			std::lock_guard<std::mutex> guard(stateLock);
+			TaskQueue& queue = *queues[nextQueue];
+			nextQueue = (nextQueue + 1) % queues.size();
+			std::lock_guard<std::mutex> queueGuard(queue.lock);
+			queue.tasks.push_back(std::move(task));
+			queued++;
+			pending++;
+		}
+		wake.notify_one();
+	}
+
+	//Block until every submitted task has finished
+	void wait(){
+		std::unique_lock<std::mutex> guard(stateLock);
+		idle.wait(guard, [this]{ return pending == 0; });
+		if (failure){
+			std::exception_ptr thrown = failure;
+			failure = nullptr;
+			std::rethrow_exception(thrown);
+		}
+	}
+private:
+	struct TaskQueue{
+		std::mutex lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	void work(size_t self){
+		while (true){
+			std::function<void()> task;
+			if (take(self, task)){
+				try {
+					task();
+				} catch (...){
+					std::lock_guard<std::mutex> guard(stateLock);
+					if (!failure){ failure = std::current_exception(); }
+				}
+				std::lock_guard<std::mutex> guard(stateLock);
+				pending--;
+				if (pending == 0){ idle.notify_all(); }
+				continue;
+			}
+
+			std::unique_lock<std::mutex> guard(stateLock);
+			wake.wait(guard, [this]{ return stopping || queued > 0; });
+			if (queued == 0){ return; }
+		}
+	}
+
+	bool take(size_t self, std::function<void()>& task){
+		for (size_t offset = 0; offset < queues.size(); offset++){
+			TaskQueue& queue = *queues[(self + offset) % queues.size()];
+			std::unique_lock<std::mutex> queueGuard(queue.lock);
+			if (queue.tasks.empty()){ continue; }
+			if (offset == 0){
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			} else {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			queueGuard.unlock();
+
+			std::lock_guard<std::mutex> guard(stateLock);
+			queued--;
+			return true;
+		}
+		return false;
+	}
+
+	std::vector<std::unique_ptr<TaskQueue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex stateLock;
+	std::condition_variable wake;
+	std::condition_variable idle;
+	size_t pending;
+	size_t queued;
+	size_t nextQueue;
+	bool stopping;
+	std::exception_ptr failure;
+};
+
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define HOLEYC_DATA_TYPES
 
 #include <list>
+#include <mutex>
 #include <sstream>
 #include "err.hpp"
 #include "errors.hpp"
@@ -114,6 +115,10 @@ public:
 		// a global variable that can only be accessed
 		// in this function).
 		static std::list<BasicType *> flyweights;
+		//Procedures may be optimized on several threads at once,
+		// so the table is guarded
+		static std::mutex flyweightsLock;
+		std::lock_guard<std::mutex> guard(flyweightsLock);
 		for(BasicType * fly : flyweights){
 			if (fly->getBaseType() == base){
 				return fly;
@@ -172,6 +177,8 @@ public:
 		// a global variable that can only be accessed
 		// in this function).
 		static std::list<PtrType *> flyweights;
+		static std::mutex flyweightsLock;
+		std::lock_guard<std::mutex> guard(flyweightsLock);
 		for(PtrType * fly : flyweights){
 			if (fly->myBasicType == basicType){
 				if (fly->myLevel == level){
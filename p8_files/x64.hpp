@@ -0,0 +1,104 @@
+#ifndef HOLEYC_X64_HPP
+#define HOLEYC_X64_HPP
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace holeyc{
+
+enum X64Kind{
+	X64_INSTR, X64_LABEL, X64_DIRECTIVE
+};
+
+/**
+* One line of emitted assembly: an instruction with its operands in
+* AT&T order (source first), a label, or an assembler directive.
+* Operands are kept as their printed text, e.g. "%rax", "$5",
+* "-8(%rbp)" or "lbl_3".
+**/
+class X64Instr{
+public:
+	X64Instr(X64Kind kindIn, std::string opcodeIn,
+		std::vector<std::string> opsIn)
+	: kind(kindIn), opcode(opcodeIn), ops(opsIn){ }
+	X64Kind getKind() const { return kind; }
+	bool isInstr() const { return kind == X64_INSTR; }
+	bool isLabel() const { return kind == X64_LABEL; }
+	//For a label, its name
+	const std::string& getOpcode() const { return opcode; }
+	size_t numOps() const { return ops.size(); }
+	const std::string& getOp(size_t idx) const { return ops[idx]; }
+	void setOpcode(std::string opcodeIn){ opcode = opcodeIn; }
+	void setOp(size_t idx, std::string op){ ops[idx] = op; }
+	bool is(const std::string& opcodeIn) const {
+		return kind == X64_INSTR && opcode == opcodeIn;
+	}
+	std::string toString() const;
+
+	static bool isRegister(const std::string& op){
+		return !op.empty() && op[0] == '%';
+	}
+	static bool isImmediate(const std::string& op){
+		return !op.empty() && op[0] == '$';
+	}
+	//The low byte of a quadword register, e.g. %al for %rax
+	static std::string byteRegister(const std::string& reg);
+private:
+	X64Kind kind;
+	std::string opcode;
+	std::vector<std::string> ops;
+};
+
+/**
+* The instructions of one procedure, in order. Code generation appends
+* here instead of printing, so the peephole pass can rewrite the list
+* before anything is written out.
+**/
+class X64Code{
+public:
+	void add(std::string opcode){
+		instrs.push_back(X64Instr(X64_INSTR, opcode, {}));
+	}
+	void add(std::string opcode, std::string op){
+		instrs.push_back(X64Instr(X64_INSTR, opcode, {op}));
+	}
+	void add(std::string opcode, std::string src, std::string dst){
+		instrs.push_back(X64Instr(X64_INSTR, opcode, {src, dst}));
+	}
+	void add(std::string opcode, std::string src1, std::string src2,
+		std::string dst){
+		instrs.push_back(X64Instr(X64_INSTR, opcode, {src1, src2, dst}));
+	}
+	//A movq, left out when src and dst are the same place
+	void addMove(std::string src, std::string dst){
+		if (src != dst){ add("movq", src, dst); }
+	}
+	void addLabel(std::string name){
+		instrs.push_back(X64Instr(X64_LABEL, name, {}));
+	}
+	void addDirective(std::string text){
+		instrs.push_back(X64Instr(X64_DIRECTIVE, text, {}));
+	}
+	std::vector<X64Instr>& getInstrs(){ return instrs; }
+	//Instructions only, not labels or directives
+	size_t numInstrs() const;
+	void print(std::ostream& out) const;
+private:
+	std::vector<X64Instr> instrs;
+};
+
+/**
+* Window rewrites over a procedure's X64Code, applied until none of
+* them fires. Each rule looks at the instruction at some position and
+* a few of its neighbors, and either rewrites them in place or leaves
+* them alone. run returns how many instructions were removed.
+**/
+class X64Peephole{
+public:
+	static size_t run(X64Code& code);
+};
+
+}
+
+#endif
@@ -0,0 +1,375 @@
+#include <ostream>
+#include <algorithm>
+#include "3ac.hpp"
+#include "cfg.hpp"
+#include "cfg_regalloc.hpp"
+#include "cfg_slots.hpp"
+#include "x64.hpp"
+
+namespace holeyc{
+
+//Registers for the first six arguments, in order
+static const char * const argRegs[] = {
+	"%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9"
+};
+static const size_t numArgRegs = 6;
+
+void IRProgram::allocGlobals(){
+	for (auto global : globals){
+		SymOpd * opd = global.second;
+		opd->setMemoryLoc("gbl_" + opd->getName() + "(%rip)");
+	}
+}
+
+void IRProgram::datagenX64(std::ostream& out){
+	out << "\t.data\n";
+	//Quadwords ahead of bytes, so none of them ends up misaligned
+	std::vector<std::string> quads;
+	std::vector<std::string> bytes;
+	for (auto global : globals){
+		SymOpd * opd = global.second;
+		if (opd->getWidth() == BYTE){
+			bytes.push_back(opd->getName());
+		} else {
+			quads.push_back(opd->getName());
+		}
+	}
+	std::sort(quads.begin(), quads.end());
+	std::sort(bytes.begin(), bytes.end());
+	for (std::string name : quads){
+		out << "gbl_" << name << ":\t.quad 0\n";
+	}
+	for (std::string name : bytes){
+		out << "gbl_" << name << ":\t.byte 0\n";
+	}
+
+	std::vector<std::pair<std::string, std::string>> lits;
+	for (auto entry : strings){
+		std::string name = entry.first->getName();
+		entry.first->setStringLoc(name + "(%rip)");
+		lits.push_back({name, entry.second});
+	}
+	std::sort(lits.begin(), lits.end());
+	for (auto lit : lits){
+		out << lit.first << ":\t.asciz " << lit.second << "\n";
+	}
+}
+
+void IRProgram::toX64(std::ostream& out){
+	allocGlobals();
+	datagenX64(out);
+	out << "\t.text\n";
+	for (Procedure * proc : *procs){
+		proc->toX64(out);
+	}
+	//Nothing here needs an executable stack
+	out << "\t.section .note.GNU-stack,\"\",@progbits\n";
+}
+
+void Procedure::allocLocals(const std::map<Opd *, size_t>& slots){
+	size_t outArgs = 0;
+	bool leaf = true;
+	for (Quad * quad : *quads){
+		if (auto setArg = dynamic_cast<SetArgQuad *>(quad)){
+			size_t index = setArg->getIndex();
+			if (index > numArgRegs){
+				outArgs = std::max(outArgs, index - numArgRegs);
+			}
+		}
+		//A tail call leaves the frame before the callee runs
+		auto call = dynamic_cast<CallQuad *>(quad);
+		if ((call != nullptr && !call->isTail())
+		    || dynamic_cast<IntrinsicOutputQuad *>(quad)
+		    || dynamic_cast<IntrinsicInputQuad *>(quad)){
+			leaf = false;
+		}
+	}
+	//Calls need %rsp 16-byte aligned, which it is right after %rbp
+	// is pushed
+	auto frame = [outArgs](size_t localBytes){
+		size_t size = (localBytes + 7) / 8 * 8 + 8 * outArgs;
+		return (size + 15) / 16 * 16;
+	};
+
+	//The saved registers sit right below the frame pointer, then the
+	// quadword slots of the operands that did not get a register, then
+	// the byte slots of bools and chars, packed together below those so
+	// no quadword is misaligned. The outgoing arguments past the sixth
+	// go at the very bottom. An operand the code never mentions shares
+	// the first slot of its width with whatever else is there
+	auto slotOf = [&slots](Opd * opd){
+		auto found = slots.find(opd);
+		return found == slots.end() ? 0 : found->second;
+	};
+	size_t savedBytes = 8 * savedRegs.size();
+	size_t quadSlots = 0;
+	size_t byteSlots = 0;
+	size_t unshared = savedBytes;
+	auto count = [&](Opd * opd){
+		if (opd->inRegister()){ return; }
+		if (opd->getWidth() == BYTE){
+			byteSlots = std::max(byteSlots, slotOf(opd) + 1);
+			unshared += 1;
+		} else {
+			quadSlots = std::max(quadSlots, slotOf(opd) + 1);
+			unshared += 8;
+		}
+	};
+	for (SymOpd * formal : formals){ count(formal); }
+	for (auto local : locals){ count(local.second); }
+	for (AuxOpd * tmp : temps){ count(tmp); }
+
+	size_t bytesStart = savedBytes + 8 * quadSlots;
+	size_t localBytes = bytesStart + byteSlots;
+	//Stack arguments are found through the frame pointer, so a leaf
+	// that takes any keeps its frame
+	redZone = leaf && formals.size() <= numArgRegs && localBytes <= 128;
+	auto place = [&](auto opd){
+		if (opd->inRegister()){ return; }
+		size_t offset = savedBytes + 8 * (slotOf(opd) + 1);
+		if (opd->getWidth() == BYTE){
+			offset = bytesStart + slotOf(opd) + 1;
+		}
+		opd->setMemoryLoc(frameLoc(offset));
+	};
+	for (SymOpd * formal : formals){ place(formal); }
+	for (auto local : locals){ place(local.second); }
+	for (AuxOpd * tmp : temps){ place(tmp); }
+
+	frameSize = redZone ? localBytes : frame(localBytes);
+	addStat("slots.before", frame(unshared));
+	addStat("slots.after", frameSize);
+	addStat("frame.redzone", redZone ? 1 : 0);
+}
+
+std::string Procedure::frameLoc(size_t offset){
+	std::string base = redZone ? "(%rsp)" : "(%rbp)";
+	return "-" + std::to_string(offset) + base;
+}
+
+std::string Procedure::savedRegLoc(size_t idx){
+	return frameLoc(8 * (idx + 1));
+}
+
+void Procedure::toX64(std::ostream& out){
+	//Registers are picked on the quads as they stand, after whatever
+	// optimization has already been applied to them
+	ControlFlowGraph * cfg = CFGFactory::buildCFG(this);
+	savedRegs = LinearScan::run(cfg);
+	allocLocals(SlotColoring::run(cfg));
+
+	X64Code code;
+	if (myName == "main"){
+		code.addDirective(".globl main");
+	}
+	for (Quad * quad : *quads){
+		quad->codegenLabels(code);
+		quad->codegenX64(code);
+	}
+	addStat("peephole.removed", X64Peephole::run(code));
+	code.print(out);
+}
+
+void Quad::codegenLabels(X64Code& code){
+	for (Label * label : labels){
+		code.addLabel(label->getName());
+	}
+}
+
+void JmpQuad::codegenX64(X64Code& code){
+	code.add("jmp", tgt->getName());
+}
+
+void NopQuad::codegenX64(X64Code& code){
+	code.add("nop");
+}
+
+void PhiQuad::codegenX64(X64Code& code){
+	throw new InternalError("Phi left in code generation");
+}
+
+void IntrinsicOutputQuad::codegenX64(X64Code& code){
+	myArg->genLoad(code, "%rdi");
+	if (myType->isPtr()){
+		code.add("callq", "printString");
+	} else if (myType->isBool()){
+		code.add("callq", "printBool");
+	} else if (myType->isChar()){
+		code.add("callq", "printChar");
+	} else {
+		code.add("callq", "printInt");
+	}
+}
+
+void IntrinsicInputQuad::codegenX64(X64Code& code){
+	if (myType->isBool()){
+		code.add("callq", "getBool");
+	} else if (myType->isChar()){
+		code.add("callq", "getChar");
+	} else {
+		code.add("callq", "getInt");
+	}
+	//Byte results only fill %al
+	if (myArg->getWidth() == BYTE){
+		code.add("movzbq", "%al", "%rax");
+	}
+	myArg->genStore(code, "%rax");
+}
+
+//Restores what EnterQuad saved and pops the frame, which leaves %rsp
+// at the return address
+static void genEpilogue(X64Code& code, Procedure * proc){
+	const std::vector<std::string>& saved = proc->getSavedRegs();
+	for (size_t idx = 0; idx < saved.size(); idx++){
+		code.addMove(proc->savedRegLoc(idx), saved[idx]);
+	}
+	if (!proc->usesRedZone()){
+		if (proc->arSize() > 0){
+			code.add("addq", "$" + std::to_string(proc->arSize()), 
+				"%rsp");
+		}
+		code.add("popq", "%rbp");
+	}
+}
+
+//The arguments are already in their registers, and the epilogue only
+// touches callee-saved ones, so a tail call can drop the frame first
+void CallQuad::codegenX64(X64Code& code){
+	std::string target = "fun_" + callee->getName();
+	if (callee->getName() == "main"){
+		target = "main";
+	}
+	if (tailOf != nullptr){
+		genEpilogue(code, tailOf);
+		code.add("jmp", target);
+	} else {
+		code.add("callq", target);
+	}
+}
+
+void EnterQuad::codegenX64(X64Code& code){
+	if (!myProc->usesRedZone()){
+		code.add("pushq", "%rbp");
+		code.add("movq", "%rsp", "%rbp");
+		if (myProc->arSize() > 0){
+			code.add("subq", "$" + std::to_string(myProc->arSize()), 
+				"%rsp");
+		}
+	}
+	const std::vector<std::string>& saved = myProc->getSavedRegs();
+	for (size_t idx = 0; idx < saved.size(); idx++){
+		code.addMove(saved[idx], myProc->savedRegLoc(idx));
+	}
+}
+
+void LeaveQuad::codegenX64(X64Code& code){
+	genEpilogue(code, myProc);
+	code.add("retq");
+}
+
+//Arguments past the sixth go on the stack, in the outgoing area at
+// the bottom of the caller's frame
+void SetArgQuad::codegenX64(X64Code& code){
+	if (index <= numArgRegs){
+		opd->genLoad(code, argRegs[index - 1]);
+		return;
+	}
+	opd->genLoad(code, "%rax");
+	size_t offset = 8 * (index - numArgRegs - 1);
+	code.add("movq", "%rax", std::to_string(offset) + "(%rsp)");
+}
+
+//Stack arguments start above the return address and the saved %rbp
+void GetArgQuad::codegenX64(X64Code& code){
+	if (index <= numArgRegs){
+		opd->genStore(code, argRegs[index - 1]);
+		return;
+	}
+	size_t offset = 16 + 8 * (index - numArgRegs - 1);
+	code.add("movq", std::to_string(offset) + "(%rbp)", "%rax");
+	opd->genStore(code, "%rax");
+}
+
+void SetRetQuad::codegenX64(X64Code& code){
+	opd->genLoad(code, "%rax");
+}
+
+void GetRetQuad::codegenX64(X64Code& code){
+	opd->genStore(code, "%rax");
+}
+
+//A register always holds the whole quadword, zero-extended for a
+// bool or a char, but in memory those take a single byte
+static void genWidthLoad(X64Code& code, Opd * opd, std::string dstReg){
+	if (!opd->inRegister() && opd->getWidth() == BYTE){
+		code.add("movzbq", opd->operandX64(), dstReg);
+	} else {
+		code.addMove(opd->operandX64(), dstReg);
+	}
+}
+
+static void genWidthStore(X64Code& code, Opd * opd, std::string srcReg){
+	if (!opd->inRegister() && opd->getWidth() == BYTE){
+		code.add("movb", X64Instr::byteRegister(srcReg), opd->operandX64());
+	} else {
+		code.addMove(srcReg, opd->operandX64());
+	}
+}
+
+std::string SymOpd::operandX64(){
+	return inRegister() ? getRegister() : myLoc;
+}
+
+void SymOpd::genLoad(X64Code& code, std::string dstReg){
+	genWidthLoad(code, this, dstReg);
+}
+
+void SymOpd::genStore(X64Code& code, std::string srcReg){
+	genWidthStore(code, this, srcReg);
+}
+
+//A string is only usable through its address, which genLoad computes
+std::string AuxOpd::operandX64(){
+	if (isString){
+		throw new InternalError("String literal used as an operand");
+	}
+	return inRegister() ? getRegister() : myLoc;
+}
+
+void AuxOpd::genLoad(X64Code& code, std::string dstReg){
+	if (isString){
+		code.add("leaq", myLoc, dstReg);
+		return;
+	}
+	genWidthLoad(code, this, dstReg);
+}
+
+void AuxOpd::genStore(X64Code& code, std::string srcReg){
+	genWidthStore(code, this, srcReg);
+}
+
+std::string LitOpd::operandX64(){
+	return "$" + val;
+}
+
+void LitOpd::genLoad(X64Code& code, std::string dstReg){
+	code.add("movq", operandX64(), dstReg);
+}
+
+void LitOpd::genStore(X64Code& code, std::string srcReg){
+	throw new InternalError("Tried to store to a constant");
+}
+
+std::string SSAOpd::operandX64(){
+	throw new InternalError("SSA operand left in code generation");
+}
+
+void SSAOpd::genLoad(X64Code& code, std::string dstReg){
+	throw new InternalError("SSA operand left in code generation");
+}
+
+void SSAOpd::genStore(X64Code& code, std::string srcReg){
+	throw new InternalError("SSA operand left in code generation");
+}
+
+}
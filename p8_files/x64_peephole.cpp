@@ -0,0 +1,197 @@
+#include <map>
+#include "x64.hpp"
+
+namespace holeyc{
+
+std::string X64Instr::toString() const {
+	if (kind == X64_LABEL){
+		return opcode + ":";
+	}
+	std::string res = "\t" + opcode;
+	for (size_t idx = 0; idx < ops.size(); idx++){
+		res += idx == 0 ? " " : ", ";
+		res += ops[idx];
+	}
+	return res;
+}
+
+std::string X64Instr::byteRegister(const std::string& reg){
+	//%r8 through %r15 just take a suffix
+	if (reg.size() > 2 && reg[2] >= '0' && reg[2] <= '9'){
+		return reg + "b";
+	}
+	static const std::map<std::string, std::string> low = {
+		{"%rax", "%al"}, {"%rbx", "%bl"}, {"%rcx", "%cl"},
+		{"%rdx", "%dl"}, {"%rsi", "%sil"}, {"%rdi", "%dil"},
+	};
+	return low.at(reg);
+}
+
+size_t X64Code::numInstrs() const {
+	size_t count = 0;
+	for (const X64Instr& instr : instrs){
+		if (instr.isInstr()){ count++; }
+	}
+	return count;
+}
+
+void X64Code::print(std::ostream& out) const {
+	for (const X64Instr& instr : instrs){
+		out << instr.toString() << "\n";
+	}
+}
+
+typedef std::vector<X64Instr> X64Instrs;
+
+static bool isMove(const X64Instrs& code, size_t pos){
+	return pos < code.size() && code[pos].is("movq");
+}
+
+static bool isJump(const X64Instr& instr){
+	return instr.isInstr() && instr.getOpcode()[0] == 'j';
+}
+
+//The label at pos, or one right after it, is named target
+static bool labelFollows(const X64Instrs& code, size_t pos,
+	const std::string& target){
+	for (; pos < code.size() && code[pos].isLabel(); pos++){
+		if (code[pos].getOpcode() == target){ return true; }
+	}
+	return false;
+}
+
+//movq A, A
+static bool selfMove(X64Instrs& code, size_t pos){
+	if (!isMove(code, pos)){ return false; }
+	if (code[pos].getOp(0) != code[pos].getOp(1)){ return false; }
+	code.erase(code.begin() + static_cast<long>(pos));
+	return true;
+}
+
+//movq A, B followed by movq B, A (or by movq A, B again): after the
+// first move both already hold the same value
+static bool redundantMove(X64Instrs& code, size_t pos){
+	if (!isMove(code, pos) || !isMove(code, pos + 1)){ return false; }
+	const std::string& src = code[pos].getOp(0);
+	const std::string& dst = code[pos].getOp(1);
+	//A store into a register that src is addressed through
+	if (src.find(dst) != std::string::npos){ return false; }
+	const X64Instr& next = code[pos + 1];
+	bool back = next.getOp(0) == dst && next.getOp(1) == src;
+	bool again = next.getOp(0) == src && next.getOp(1) == dst;
+	if (!back && !again){ return false; }
+	code.erase(code.begin() + static_cast<long>(pos + 1));
+	return true;
+}
+
+static bool nop(X64Instrs& code, size_t pos){
+	if (!code[pos].is("nop")){ return false; }
+	code.erase(code.begin() + static_cast<long>(pos));
+	return true;
+}
+
+//A jump (taken or not) to the label right after it
+static bool jumpToNext(X64Instrs& code, size_t pos){
+	if (!isJump(code[pos])){ return false; }
+	if (!labelFollows(code, pos + 1, code[pos].getOp(0))){ return false; }
+	code.erase(code.begin() + static_cast<long>(pos));
+	return true;
+}
+
+//jcc L1; jmp L2; L1: becomes jncc L2; L1:
+static bool branchOverJump(X64Instrs& code, size_t pos){
+	static const std::map<std::string, std::string> inverse = {
+		{"je", "jne"}, {"jne", "je"},
+		{"jl", "jge"}, {"jge", "jl"},
+		{"jg", "jle"}, {"jle", "jg"},
+	};
+	if (!code[pos].isInstr()){ return false; }
+	auto flipped = inverse.find(code[pos].getOpcode());
+	if (flipped == inverse.end()){ return false; }
+	if (pos + 1 >= code.size() || !code[pos + 1].is("jmp")){
+		return false;
+	}
+	if (!labelFollows(code, pos + 2, code[pos].getOp(0))){
+		return false;
+	}
+	code[pos].setOpcode(flipped->second);
+	code[pos].setOp(0, code[pos + 1].getOp(0));
+	code.erase(code.begin() + static_cast<long>(pos + 1));
+	return true;
+}
+
+//Instructions between an unconditional transfer and the next label
+static bool unreachable(X64Instrs& code, size_t pos){
+	if (!code[pos].is("jmp") && !code[pos].is("retq")){ return false; }
+	size_t end = pos + 1;
+	while (end < code.size() && code[end].isInstr()){ end++; }
+	if (end == pos + 1){ return false; }
+	code.erase(code.begin() + static_cast<long>(pos + 1),
+		code.begin() + static_cast<long>(end));
+	return true;
+}
+
+//cmpq $0, R ahead of je/jne, when the last write to R was arithmetic
+// that already set ZF from the same value. Only moves that leave R
+// alone may come in between; they do not touch the flags
+static bool redundantCompare(X64Instrs& code, size_t pos){
+	static const std::vector<std::string> setsZero = {
+		"addq", "subq", "andq", "orq", "xorq", "negq", "incq", "decq"
+	};
+	const X64Instr& cmp = code[pos];
+	if (!cmp.is("cmpq") || cmp.getOp(0) != "$0"){ return false; }
+	const std::string& reg = cmp.getOp(1);
+	if (pos + 1 >= code.size()){ return false; }
+	if (!code[pos + 1].is("je") && !code[pos + 1].is("jne")){
+		return false;
+	}
+
+	for (size_t back = pos; back > 0; back--){
+		const X64Instr& prev = code[back - 1];
+		if (!prev.isInstr() || prev.numOps() == 0){ return false; }
+		const std::string& written = prev.getOp(prev.numOps() - 1);
+		if (prev.is("movq") && written != reg){ continue; }
+		if (written != reg){ return false; }
+		for (const std::string& opcode : setsZero){
+			if (prev.is(opcode)){
+				code.erase(code.begin() + static_cast<long>(pos));
+				return true;
+			}
+		}
+		return false;
+	}
+	return false;
+}
+
+struct PeepholeRule{
+	const char * name;
+	bool (*apply)(X64Instrs& code, size_t pos);
+};
+
+static const PeepholeRule rules[] = {
+	{"self move", selfMove},
+	{"redundant move", redundantMove},
+	{"nop", nop},
+	{"jump to next", jumpToNext},
+	{"branch over jump", branchOverJump},
+	{"unreachable", unreachable},
+	{"redundant compare", redundantCompare},
+};
+
+size_t X64Peephole::run(X64Code& code){
+	X64Instrs& instrs = code.getInstrs();
+	size_t before = code.numInstrs();
+	bool changed = true;
+	while (changed){
+		changed = false;
+		for (size_t pos = 0; pos < instrs.size(); pos++){
+			for (const PeepholeRule& rule : rules){
+				if (pos >= instrs.size()){ break; }
+				if (rule.apply(instrs, pos)){ changed = true; }
+			}
+		}
+	}
+	return before - code.numInstrs();
+}
+
+}
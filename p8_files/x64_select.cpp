@@ -0,0 +1,603 @@
+#include "3ac.hpp"
+#include "x64.hpp"
+
+namespace holeyc{
+
+/**
+* Instruction selection for the quads that have more than one good
+* lowering. Each quad kind has a table of patterns, tried in order;
+* a pattern either emits code for the quad and returns true or leaves
+* the code alone and returns false. The last pattern of every table
+* matches anything, going through %rax (and %rcx) the long way.
+**/
+template <typename QuadType>
+struct X64Pattern{
+	const char * name;
+	bool (*select)(QuadType * quad, X64Code& code);
+};
+
+template <typename QuadType, size_t N>
+static void selectX64(const X64Pattern<QuadType> (&patterns)[N],
+	QuadType * quad, X64Code& code){
+	for (const X64Pattern<QuadType>& pattern : patterns){
+		if (pattern.select(quad, code)){ return; }
+	}
+	throw new InternalError("No x64 pattern matched a quad");
+}
+
+enum X64OpdKind{
+	X64_REG, X64_MEM, X64_MEM8, X64_IMM, X64_NONE
+};
+
+//Where an operand can be used directly. Literals too wide for a
+// sign-extended 32-bit immediate, and strings, which are addresses,
+// have to be loaded first. A bool or char in memory (X64_MEM8) is a
+// single byte, which only the b-suffixed instructions may touch
+static X64OpdKind kindOf(Opd * opd){
+	if (auto lit = dynamic_cast<LitOpd *>(opd)){
+		long long val = std::stoll(lit->valString());
+		if (val < -2147483648LL || val > 2147483647LL){ return X64_NONE; }
+		return X64_IMM;
+	}
+	if (auto aux = dynamic_cast<AuxOpd *>(opd)){
+		if (aux->isStringLit()){ return X64_NONE; }
+	}
+	if (opd->inRegister()){ return X64_REG; }
+	return opd->getWidth() == BYTE ? X64_MEM8 : X64_MEM;
+}
+
+static bool isReg(Opd * opd){ return kindOf(opd) == X64_REG; }
+
+//Readable straight from a q-suffixed instruction that uses it
+static bool isDirect(Opd * opd){
+	X64OpdKind kind = kindOf(opd);
+	return kind != X64_NONE && kind != X64_MEM8;
+}
+
+static bool sameLoc(Opd * a, Opd * b){
+	X64OpdKind kind = kindOf(a);
+	if (kind != X64_REG && kind != X64_MEM){ return false; }
+	if (kindOf(b) != kind){ return false; }
+	return a->operandX64() == b->operandX64();
+}
+
+static bool isLit(Opd * opd, const char * val){
+	auto lit = dynamic_cast<LitOpd *>(opd);
+	return lit != nullptr && lit->valString() == val;
+}
+
+//At most one side of a two-operand instruction may be in memory
+static bool encodable(Opd * src, Opd * dst){
+	return isDirect(src) &&
+		(kindOf(src) != X64_MEM || kindOf(dst) != X64_MEM);
+}
+
+static std::string arithOpcode(BinOp op){
+	switch (op){
+	case ADD: return "addq";
+	case SUB: return "subq";
+	case MULT: return "imulq";
+	case AND: return "andq";
+	case OR: return "orq";
+	default: return "";
+	}
+}
+
+static bool commutes(BinOp op){
+	return op == ADD || op == MULT || op == AND || op == OR;
+}
+
+static std::string setOpcode(BinOp op){
+	switch (op){
+	case EQ: return "sete";
+	case NEQ: return "setne";
+	case LT: return "setl";
+	case GT: return "setg";
+	case LTE: return "setle";
+	case GTE: return "setge";
+	default: return "";
+	}
+}
+
+static std::string jumpOpcode(BinOp op){
+	switch (op){
+	case EQ: return "je";
+	case NEQ: return "jne";
+	case LT: return "jl";
+	case GT: return "jg";
+	case LTE: return "jle";
+	case GTE: return "jge";
+	default: return "";
+	}
+}
+
+//The comparison that holds with the operands the other way around
+static BinOp swapCompare(BinOp op){
+	switch (op){
+	case LT: return GT;
+	case GT: return LT;
+	case LTE: return GTE;
+	case GTE: return LTE;
+	default: return op;
+	}
+}
+
+//x := x + 1, x := 1 + x, x := x - 1
+static bool selectIncDec(BinOpQuad * quad, X64Code& code){
+	Opd * dst = quad->getDst();
+	Opd * src1 = quad->getSrc1();
+	Opd * src2 = quad->getSrc2();
+	if (quad->getOp() == ADD){
+		if ((sameLoc(dst, src1) && isLit(src2, "1"))
+		    || (sameLoc(dst, src2) && isLit(src1, "1"))){
+			code.add("incq", dst->operandX64());
+			return true;
+		}
+	} else if (quad->getOp() == SUB){
+		if (sameLoc(dst, src1) && isLit(src2, "1")){
+			code.add("decq", dst->operandX64());
+			return true;
+		}
+	}
+	return false;
+}
+
+//The literal's value, as a count that a shift or a leaq scale can use
+// once the sign is taken off
+static bool litFactor(Opd * opd, bool& negative, unsigned long& mag){
+	auto lit = dynamic_cast<LitOpd *>(opd);
+	if (lit == nullptr){ return false; }
+	long long val = std::stoll(lit->valString());
+	negative = val < 0;
+	mag = static_cast<unsigned long>(val);
+	if (negative){ mag = 0 - mag; }
+	return true;
+}
+
+static unsigned log2Exact(unsigned long val){
+	unsigned k = 0;
+	while ((val >> k) != 1){ k++; }
+	return k;
+}
+
+static bool isPow2(unsigned long val){
+	return val != 0 && (val & (val - 1)) == 0;
+}
+
+//r := a * c where c is 2^k times at most two of 3, 5 and 9: one leaq
+// per odd factor and a shift for the rest, each cheaper than imulq
+static bool selectMulConst(BinOpQuad * quad, X64Code& code){
+	if (quad->getOp() != MULT){ return false; }
+	Opd * src1 = quad->getSrc1();
+	Opd * src2 = quad->getSrc2();
+	if (dynamic_cast<LitOpd *>(src1) != nullptr
+	    && dynamic_cast<LitOpd *>(src2) == nullptr){
+		std::swap(src1, src2);
+	}
+	bool negative;
+	unsigned long factor;
+	if (!litFactor(src2, negative, factor) || factor < 2){ return false; }
+
+	unsigned shift = 0;
+	while ((factor & 1) == 0){
+		factor >>= 1;
+		shift++;
+	}
+	std::vector<unsigned long> scales;
+	for (unsigned long scale : {9ul, 5ul, 3ul}){
+		while (factor % scale == 0 && scales.size() < 2){
+			factor /= scale;
+			scales.push_back(scale);
+		}
+	}
+	if (factor != 1){ return false; }
+
+	Opd * dst = quad->getDst();
+	std::string reg = isReg(dst) ? dst->operandX64() : "%rax";
+	src1->genLoad(code, reg);
+	for (unsigned long scale : scales){
+		code.add("leaq", "(" + reg + "," + reg + ","
+			+ std::to_string(scale - 1) + ")", reg);
+	}
+	if (shift > 0){
+		code.add("salq", "$" + std::to_string(shift), reg);
+	}
+	if (negative){ code.add("negq", reg); }
+	dst->genStore(code, reg);
+	return true;
+}
+
+//The multiplier and shift that turn signed division by d (at least 2
+// and not a power of two) into a multiply-high, as in Hacker's Delight
+static void divMagic(unsigned long d, unsigned long& magic, unsigned& shift){
+	const unsigned long two63 = 1ul << 63;
+	unsigned long anc = two63 - 1 - two63 % d;
+	unsigned long q1 = two63 / anc;
+	unsigned long r1 = two63 - q1 * anc;
+	unsigned long q2 = two63 / d;
+	unsigned long r2 = two63 - q2 * d;
+	unsigned p = 63;
+	unsigned long delta;
+	do {
+		p++;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= anc){ q1++; r1 -= anc; }
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= d){ q2++; r2 -= d; }
+		delta = d - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+	magic = q2 + 1;
+	shift = p - 64;
+}
+
+//r := a / c without idivq. Quotients truncate toward zero, so a
+// negative dividend is biased by c - 1 before a shift, and a negative
+// divisor negates the quotient by its magnitude. Division by 0 and by
+// -1 are left to idivq, which faults on them as the program would
+static bool selectDivConst(BinOpQuad * quad, X64Code& code){
+	if (quad->getOp() != DIV){ return false; }
+	bool negative;
+	unsigned long divisor;
+	if (!litFactor(quad->getSrc2(), negative, divisor)){ return false; }
+	if (divisor == 0 || (negative && divisor == 1)){ return false; }
+	Opd * dividend = quad->getSrc1();
+	Opd * dst = quad->getDst();
+
+	if (divisor == 1){
+		std::string reg = isReg(dst) ? dst->operandX64() : "%rax";
+		dividend->genLoad(code, reg);
+		dst->genStore(code, reg);
+		return true;
+	}
+
+	if (isPow2(divisor)){
+		unsigned k = log2Exact(divisor);
+		dividend->genLoad(code, "%rax");
+		code.add("movq", "%rax", "%rdx");
+		if (k > 1){ code.add("sarq", "$63", "%rdx"); }
+		code.add("shrq", "$" + std::to_string(64 - k), "%rdx");
+		code.add("addq", "%rdx", "%rax");
+		code.add("sarq", "$" + std::to_string(k), "%rax");
+		if (negative){ code.add("negq", "%rax"); }
+		dst->genStore(code, "%rax");
+		return true;
+	}
+
+	unsigned long magic;
+	unsigned shift;
+	divMagic(divisor, magic, shift);
+	dividend->genLoad(code, "%rcx");
+	code.add("movq", "$" + std::to_string(static_cast<long>(magic)),
+		"%rax");
+	code.add("imulq", "%rcx");
+	//The multiplier went past 2^63 and was read as negative
+	if (magic >= 1ul << 63){ code.add("addq", "%rcx", "%rdx"); }
+	if (shift > 0){
+		code.add("sarq", "$" + std::to_string(shift), "%rdx");
+	}
+	code.add("movq", "%rcx", "%rax");
+	code.add("shrq", "$63", "%rax");
+	code.add("addq", "%rax", "%rdx");
+	if (negative){ code.add("negq", "%rdx"); }
+	dst->genStore(code, "%rdx");
+	return true;
+}
+
+//x := x op y (or y op x when op commutes) as one instruction on x
+static bool selectInPlace(BinOpQuad * quad, X64Code& code){
+	std::string opcode = arithOpcode(quad->getOp());
+	if (opcode == ""){ return false; }
+	Opd * dst = quad->getDst();
+	Opd * other;
+	if (sameLoc(dst, quad->getSrc1())){
+		other = quad->getSrc2();
+	} else if (commutes(quad->getOp()) && sameLoc(dst, quad->getSrc2())){
+		other = quad->getSrc1();
+	} else {
+		return false;
+	}
+	//imulq can only write a register
+	if (quad->getOp() == MULT && !isReg(dst)){ return false; }
+	if (!encodable(other, dst)){ return false; }
+	code.add(opcode, other->operandX64(), dst->operandX64());
+	return true;
+}
+
+//r := a + imm or r := a + b with everything in registers
+static bool selectLea(BinOpQuad * quad, X64Code& code){
+	Opd * dst = quad->getDst();
+	Opd * src1 = quad->getSrc1();
+	Opd * src2 = quad->getSrc2();
+	if (quad->getOp() != ADD || !isReg(dst)){ return false; }
+	if (isReg(src2) && kindOf(src1) == X64_IMM){
+		std::swap(src1, src2);
+	}
+	if (!isReg(src1)){ return false; }
+	if (kindOf(src2) == X64_IMM){
+		code.add("leaq", src2->valString() + "(" + src1->operandX64() + ")",
+			dst->operandX64());
+		return true;
+	}
+	if (isReg(src2)){
+		code.add("leaq", "(" + src1->operandX64() + ","
+			+ src2->operandX64() + ")", dst->operandX64());
+		return true;
+	}
+	return false;
+}
+
+//r := a * imm, with the three-operand imulq
+static bool selectMulImm(BinOpQuad * quad, X64Code& code){
+	Opd * dst = quad->getDst();
+	Opd * src1 = quad->getSrc1();
+	Opd * src2 = quad->getSrc2();
+	if (quad->getOp() != MULT || !isReg(dst)){ return false; }
+	if (kindOf(src1) == X64_IMM){
+		std::swap(src1, src2);
+	}
+	if (kindOf(src2) != X64_IMM){ return false; }
+	X64OpdKind kind = kindOf(src1);
+	if (kind != X64_REG && kind != X64_MEM){ return false; }
+	code.add("imulq", src2->operandX64(), src1->operandX64(),
+		dst->operandX64());
+	return true;
+}
+
+//r := a op b, computed in r itself when b does not live there
+static bool selectIntoReg(BinOpQuad * quad, X64Code& code){
+	std::string opcode = arithOpcode(quad->getOp());
+	Opd * dst = quad->getDst();
+	Opd * src2 = quad->getSrc2();
+	if (opcode == "" || !isReg(dst)){ return false; }
+	if (!isDirect(src2) || sameLoc(dst, src2)){ return false; }
+	quad->getSrc1()->genLoad(code, dst->operandX64());
+	code.add(opcode, src2->operandX64(), dst->operandX64());
+	return true;
+}
+
+static void genSetcc(X64Code& code, BinOp op, Opd * dst){
+	if (kindOf(dst) == X64_MEM8){
+		code.add(setOpcode(op), dst->operandX64());
+		return;
+	}
+	code.add(setOpcode(op), "%al");
+	if (isReg(dst)){
+		code.add("movzbq", "%al", dst->operandX64());
+	} else {
+		code.add("movzbq", "%al", "%rax");
+		dst->genStore(code, "%rax");
+	}
+}
+
+//A comparison with both sides used in place. A constant on the left
+// is moved to the right, where cmpq allows it
+static bool selectCompare(BinOpQuad * quad, X64Code& code){
+	BinOp op = quad->getOp();
+	if (setOpcode(op) == ""){ return false; }
+	Opd * left = quad->getSrc1();
+	Opd * right = quad->getSrc2();
+	if (kindOf(left) == X64_IMM && kindOf(right) != X64_IMM){
+		std::swap(left, right);
+		op = swapCompare(op);
+	}
+	X64OpdKind kind = kindOf(left);
+	if (kind != X64_REG && kind != X64_MEM){ return false; }
+	if (!encodable(right, left)){ return false; }
+	code.add("cmpq", right->operandX64(), left->operandX64());
+	genSetcc(code, op, quad->getDst());
+	return true;
+}
+
+//idivq takes its divisor from a register or memory
+static bool selectDivide(BinOpQuad * quad, X64Code& code){
+	if (quad->getOp() != DIV){ return false; }
+	quad->getSrc1()->genLoad(code, "%rax");
+	code.add("cqto");
+	Opd * divisor = quad->getSrc2();
+	X64OpdKind kind = kindOf(divisor);
+	if (kind == X64_REG || kind == X64_MEM){
+		code.add("idivq", divisor->operandX64());
+	} else {
+		divisor->genLoad(code, "%rcx");
+		code.add("idivq", "%rcx");
+	}
+	quad->getDst()->genStore(code, "%rax");
+	return true;
+}
+
+static bool selectBinOpAny(BinOpQuad * quad, X64Code& code){
+	quad->getSrc1()->genLoad(code, "%rax");
+	Opd * src2 = quad->getSrc2();
+	std::string operand = "%rcx";
+	if (isDirect(src2)){
+		operand = src2->operandX64();
+	} else {
+		src2->genLoad(code, "%rcx");
+	}
+	std::string opcode = arithOpcode(quad->getOp());
+	if (opcode != ""){
+		code.add(opcode, operand, "%rax");
+		quad->getDst()->genStore(code, "%rax");
+	} else {
+		code.add("cmpq", operand, "%rax");
+		genSetcc(code, quad->getOp(), quad->getDst());
+	}
+	return true;
+}
+
+static const X64Pattern<BinOpQuad> binOpPatterns[] = {
+	{"inc/dec", selectIncDec},
+	{"multiply by constant", selectMulConst},
+	{"divide by constant", selectDivConst},
+	{"in place", selectInPlace},
+	{"lea", selectLea},
+	{"multiply by immediate", selectMulImm},
+	{"into register", selectIntoReg},
+	{"compare", selectCompare},
+	{"divide", selectDivide},
+	{"any", selectBinOpAny},
+};
+
+void BinOpQuad::codegenX64(X64Code& code){
+	selectX64(binOpPatterns, this, code);
+}
+
+static void genUnary(UnaryOpQuad * quad, X64Code& code, std::string loc){
+	if (quad->getOp() == NEG){
+		code.add("negq", loc);
+	} else {
+		code.add("xorq", "$1", loc);
+	}
+}
+
+static bool selectUnaryInPlace(UnaryOpQuad * quad, X64Code& code){
+	if (!sameLoc(quad->getDst(), quad->getSrc())){ return false; }
+	genUnary(quad, code, quad->getDst()->operandX64());
+	return true;
+}
+
+static bool selectUnaryIntoReg(UnaryOpQuad * quad, X64Code& code){
+	if (!isReg(quad->getDst())){ return false; }
+	std::string reg = quad->getDst()->operandX64();
+	quad->getSrc()->genLoad(code, reg);
+	genUnary(quad, code, reg);
+	return true;
+}
+
+static bool selectUnaryAny(UnaryOpQuad * quad, X64Code& code){
+	quad->getSrc()->genLoad(code, "%rax");
+	genUnary(quad, code, "%rax");
+	quad->getDst()->genStore(code, "%rax");
+	return true;
+}
+
+static const X64Pattern<UnaryOpQuad> unaryOpPatterns[] = {
+	{"in place", selectUnaryInPlace},
+	{"into register", selectUnaryIntoReg},
+	{"any", selectUnaryAny},
+};
+
+void UnaryOpQuad::codegenX64(X64Code& code){
+	selectX64(unaryOpPatterns, this, code);
+}
+
+static bool selectAssignToReg(AssignQuad * quad, X64Code& code){
+	if (!isReg(quad->getDst())){ return false; }
+	quad->getSrc()->genLoad(code, quad->getDst()->operandX64());
+	return true;
+}
+
+static bool selectAssignDirect(AssignQuad * quad, X64Code& code){
+	Opd * src = quad->getSrc();
+	Opd * dst = quad->getDst();
+	X64OpdKind kind = kindOf(src);
+	if (kind == X64_REG){
+		dst->genStore(code, src->operandX64());
+	} else if (kind == X64_IMM){
+		std::string opcode = kindOf(dst) == X64_MEM8 ? "movb" : "movq";
+		code.add(opcode, src->operandX64(), dst->operandX64());
+	} else {
+		return false;
+	}
+	return true;
+}
+
+static bool selectAssignAny(AssignQuad * quad, X64Code& code){
+	quad->getSrc()->genLoad(code, "%rax");
+	quad->getDst()->genStore(code, "%rax");
+	return true;
+}
+
+static const X64Pattern<AssignQuad> assignPatterns[] = {
+	{"to register", selectAssignToReg},
+	{"direct", selectAssignDirect},
+	{"any", selectAssignAny},
+};
+
+void AssignQuad::codegenX64(X64Code& code){
+	selectX64(assignPatterns, this, code);
+}
+
+//A constant condition either always jumps or never does
+static bool selectJmpIfConstant(JmpIfQuad * quad, X64Code& code){
+	Opd * cnd = quad->getCnd();
+	if (dynamic_cast<LitOpd *>(cnd) == nullptr){ return false; }
+	if (isLit(cnd, "0")){
+		code.add("jmp", quad->getLabel()->getName());
+	}
+	return true;
+}
+
+//Test the condition where it lives and branch on the result
+static bool selectJmpIfDirect(JmpIfQuad * quad, X64Code& code){
+	Opd * cnd = quad->getCnd();
+	X64OpdKind kind = kindOf(cnd);
+	if (kind != X64_REG && kind != X64_MEM && kind != X64_MEM8){
+		return false;
+	}
+	code.add(kind == X64_MEM8 ? "cmpb" : "cmpq", "$0", cnd->operandX64());
+	code.add("je", quad->getLabel()->getName());
+	return true;
+}
+
+static bool selectJmpIfAny(JmpIfQuad * quad, X64Code& code){
+	quad->getCnd()->genLoad(code, "%rax");
+	code.add("cmpq", "$0", "%rax");
+	code.add("je", quad->getLabel()->getName());
+	return true;
+}
+
+static const X64Pattern<JmpIfQuad> jmpIfPatterns[] = {
+	{"constant", selectJmpIfConstant},
+	{"direct", selectJmpIfDirect},
+	{"any", selectJmpIfAny},
+};
+
+void JmpIfQuad::codegenX64(X64Code& code){
+	selectX64(jmpIfPatterns, this, code);
+}
+
+//Compare both sides where they are, as selectCompare does, and branch
+// on the flags
+static bool selectJmpCmpDirect(JmpCmpQuad * quad, X64Code& code){
+	BinOp op = quad->getOp();
+	Opd * left = quad->getSrc1();
+	Opd * right = quad->getSrc2();
+	if (kindOf(left) == X64_IMM && kindOf(right) != X64_IMM){
+		std::swap(left, right);
+		op = swapCompare(op);
+	}
+	X64OpdKind kind = kindOf(left);
+	if (kind != X64_REG && kind != X64_MEM){ return false; }
+	if (!encodable(right, left)){ return false; }
+	code.add("cmpq", right->operandX64(), left->operandX64());
+	code.add(jumpOpcode(op), quad->getLabel()->getName());
+	return true;
+}
+
+static bool selectJmpCmpAny(JmpCmpQuad * quad, X64Code& code){
+	quad->getSrc1()->genLoad(code, "%rax");
+	Opd * src2 = quad->getSrc2();
+	std::string operand = "%rcx";
+	if (isDirect(src2)){
+		operand = src2->operandX64();
+	} else {
+		src2->genLoad(code, "%rcx");
+	}
+	code.add("cmpq", operand, "%rax");
+	code.add(jumpOpcode(quad->getOp()), quad->getLabel()->getName());
+	return true;
+}
+
+static const X64Pattern<JmpCmpQuad> jmpCmpPatterns[] = {
+	{"direct", selectJmpCmpDirect},
+	{"any", selectJmpCmpAny},
+};
+
+void JmpCmpQuad::codegenX64(X64Code& code){
+	selectX64(jmpCmpPatterns, this, code);
+}
+
+}